@@ -0,0 +1,343 @@
+/**
+ * Host benchmark for the timer state machine.
+ *
+ * Drives synthetic event streams through logic_process_event() and
+ * logic_get_progress() and reports the cost per event and the actions
+ * emitted. Streams are generated up front so that only the state machine
+ * is inside the timed loop.
+ *
+ * Every scenario is also run through the switch-based dispatch the state
+ * machine had before the transition table (logic_switch.c), to compare the
+ * cost. Both must produce the same actions, progress and final state.
+ *
+ * Usage: bench_logic [-n events] [-s seed] [--max-ns limit]
+ *
+ * With --max-ns the program exits non-zero if any scenario is slower than
+ * the given number of nanoseconds per event, so it can be used as a
+ * regression gate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logic.h"
+
+uint32_t logic_process_event_switch(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us);
+
+typedef uint32_t (*dispatch_fn_t)(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us);
+
+#define DEFAULT_EVENT_COUNT 2000000u
+#define ACTION_BIT_COUNT    9
+
+/* One pre-generated input to the state machine */
+typedef struct {
+    logic_event_t event;
+    int32_t value;
+    int64_t now_us;
+} bench_event_t;
+
+#define US_PER_MS 1000
+
+/* Generator: fills events[] and sets up the initial state */
+typedef void (*bench_gen_fn)(app_state_t *state, bench_event_t *events, size_t count);
+
+typedef struct {
+    const char *name;
+    bench_gen_fn generate;
+} bench_scenario_t;
+
+typedef struct {
+    double ns_per_event;
+    uint64_t actions_emitted;
+    uint64_t action_counts[ACTION_BIT_COUNT];
+    uint64_t checksum;
+    app_state_t final_state;
+} bench_result_t;
+
+static const char *s_action_names[ACTION_BIT_COUNT] = {
+    "UPDATE_UI", "START_TIMER", "STOP_TIMER", "ALARM_START",
+    "ALARM_STOP", "BACKLIGHT_ON", "BACKLIGHT_OFF", "TOGGLE_FLASH", "SLEEP",
+};
+
+static uint32_t s_rng_state = 1;
+
+/**
+ * xorshift32 - small, fast and reproducible across platforms
+ */
+static uint32_t rng_next(void) {
+    uint32_t x = s_rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_rng_state = x;
+    return x;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Encoder spins in SETUP: bursts of quadrature counts in both directions,
+ * including sub-detent jitter that must not produce actions.
+ */
+static void gen_encoder_spin(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    int32_t encoder = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t step = (int32_t)(rng_next() % 9) - 4;  /* -4..+4 counts */
+        encoder += step;
+        events[i] = (bench_event_t){ EVT_ENCODER_CHANGE, encoder, (int64_t)i * 5 * US_PER_MS };
+    }
+}
+
+/**
+ * Brew countdowns: start, tick at 1Hz until the alarm, stop, repeat.
+ */
+static void gen_countdown(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    size_t i = 0;
+    int64_t now = 0;
+    while (i < count) {
+        events[i++] = (bench_event_t){ EVT_BUTTON_PRESS, 0, now };
+        for (uint32_t t = 0; t < state->target_time_secs && i < count; t++) {
+            now += LOGIC_US_PER_SEC;
+            events[i++] = (bench_event_t){ EVT_TICK_1HZ, 0, now };
+        }
+        if (i < count) {
+            now += LOGIC_US_PER_SEC;
+            events[i++] = (bench_event_t){ EVT_BUTTON_PRESS, 0, now };
+        }
+    }
+}
+
+/**
+ * Concurrent brews: start LOGIC_MAX_TIMERS brews a couple of seconds apart,
+ * each dialled a minute shorter, then tick until all have ended, stopping
+ * every alarm a few seconds after it starts. Exercises the deadline heap.
+ */
+static void gen_multi_brew(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    size_t i = 0;
+    int64_t now = 0;
+    int32_t encoder = 0;
+    while (i < count) {
+        int64_t start = now;
+        int64_t last_end = 0;
+        int64_t ends[LOGIC_MAX_TIMERS];
+        for (int k = 0; k < LOGIC_MAX_TIMERS && i + 1 < count; k++) {
+            /* Set 5 minutes minus k */
+            int64_t at = start + (int64_t)k * 2 * LOGIC_US_PER_SEC;
+            encoder -= LOGIC_ENCODER_DIVISOR;
+            events[i++] = (bench_event_t){ EVT_ENCODER_CHANGE, encoder, at };
+            events[i++] = (bench_event_t){ EVT_BUTTON_PRESS, 0, at + 500 * US_PER_MS };
+            ends[k] = at + 500 * US_PER_MS + (int64_t)(240 - 60 * k) * LOGIC_US_PER_SEC;
+            if (ends[k] > last_end) {
+                last_end = ends[k];
+            }
+        }
+        for (now = start + LOGIC_MAX_TIMERS * 2 * LOGIC_US_PER_SEC; now <= last_end + LOGIC_US_PER_SEC && i < count;
+             now += LOGIC_US_PER_SEC) {
+            events[i++] = (bench_event_t){ EVT_TICK_1HZ, 0, now };
+            for (int k = 0; k < LOGIC_MAX_TIMERS && i < count; k++) {
+                if (ends[k] <= now && ends[k] > now - LOGIC_US_PER_SEC) {
+                    events[i++] = (bench_event_t){ EVT_BUTTON_PRESS, 0, now + 100 * US_PER_MS };
+                }
+            }
+        }
+        /* Back to a 5 minute dial for the next round */
+        for (int k = 0; k < LOGIC_MAX_TIMERS && i < count; k++) {
+            encoder += LOGIC_ENCODER_DIVISOR;
+            events[i++] = (bench_event_t){ EVT_ENCODER_CHANGE, encoder, now };
+        }
+    }
+}
+
+/**
+ * Alarm flashing: fast ticks while in ALARM.
+ */
+static void gen_alarm_flash(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    state->state = STATE_ALARM;
+    state->remaining_time_secs = 0;
+    state->alarm_flash_on = true;
+    for (size_t i = 0; i < count; i++) {
+        events[i] = (bench_event_t){ EVT_TICK_FAST, 0, (int64_t)i * 500 * US_PER_MS };
+    }
+}
+
+/**
+ * Inactivity: SETUP times out to SLEEP, an encoder nudge wakes it again.
+ */
+static void gen_inactivity(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    int32_t encoder = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t now = (int64_t)i * 60 * LOGIC_US_PER_SEC;
+        if (i % 2 == 0) {
+            events[i] = (bench_event_t){ EVT_INACTIVITY_TIMEOUT, 0, now };
+        } else {
+            encoder += LOGIC_ENCODER_DIVISOR;
+            events[i] = (bench_event_t){ EVT_ENCODER_CHANGE, encoder, now };
+        }
+    }
+}
+
+/**
+ * Mixed: a random interleaving of every event type, weighted towards the
+ * ones that dominate on the device (ticks and encoder changes).
+ */
+static void gen_mixed(app_state_t *state, bench_event_t *events, size_t count) {
+    logic_init(state);
+    int32_t encoder = 0;
+    int64_t now = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = rng_next() % 100;
+        now += (int64_t)(rng_next() % 1000) * US_PER_MS;
+        if (r < 40) {
+            events[i] = (bench_event_t){ EVT_TICK_1HZ, 0, now };
+        } else if (r < 70) {
+            encoder += (int32_t)(rng_next() % 9) - 4;
+            events[i] = (bench_event_t){ EVT_ENCODER_CHANGE, encoder, now };
+        } else if (r < 85) {
+            events[i] = (bench_event_t){ EVT_TICK_FAST, 0, now };
+        } else if (r < 97) {
+            events[i] = (bench_event_t){ EVT_BUTTON_PRESS, 0, now };
+        } else {
+            events[i] = (bench_event_t){ EVT_INACTIVITY_TIMEOUT, 0, now };
+        }
+    }
+}
+
+static const bench_scenario_t s_scenarios[] = {
+    { "encoder_spin", gen_encoder_spin },
+    { "countdown",    gen_countdown },
+    { "multi_brew",   gen_multi_brew },
+    { "alarm_flash",  gen_alarm_flash },
+    { "inactivity",   gen_inactivity },
+    { "mixed",        gen_mixed },
+};
+static const size_t s_scenario_count = sizeof(s_scenarios) / sizeof(s_scenarios[0]);
+
+/**
+ * Run a scenario through one dispatch implementation. The event stream is
+ * regenerated from the same seed, so every implementation sees the same one.
+ */
+static void run_scenario(const bench_scenario_t *scenario, dispatch_fn_t dispatch, uint32_t seed,
+                         bench_event_t *events, size_t count, bench_result_t *result) {
+    app_state_t state;
+    s_rng_state = seed;
+    scenario->generate(&state, events, count);
+
+    memset(result, 0, sizeof(*result));
+    uint64_t checksum = 0;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t actions = dispatch(&state, events[i].event, events[i].value, events[i].now_us);
+        checksum += logic_get_progress(&state) + actions;
+        if (actions != ACTION_NONE) {
+            result->actions_emitted++;
+            for (int bit = 0; bit < ACTION_BIT_COUNT; bit++) {
+                result->action_counts[bit] += (actions >> bit) & 1u;
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    result->ns_per_event = (double)elapsed / (double)count;
+    result->checksum = checksum;
+    result->final_state = state;
+}
+
+/**
+ * Whether two runs ended in the same state (field by field, as the struct
+ * has padding)
+ */
+static bool same_state(const app_state_t *a, const app_state_t *b) {
+    if (a->state != b->state || a->target_time_secs != b->target_time_secs ||
+        a->remaining_time_secs != b->remaining_time_secs || a->last_encoder_count != b->last_encoder_count ||
+        a->alarm_flash_on != b->alarm_flash_on || a->timer_count != b->timer_count) {
+        return false;
+    }
+    for (uint8_t i = 0; i < a->timer_count; i++) {
+        if (a->timers[i].deadline_us != b->timers[i].deadline_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n events] [-s seed] [--max-ns limit]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    size_t count = DEFAULT_EVENT_COUNT;
+    double max_ns = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            s_rng_state = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (s_rng_state == 0) {
+                s_rng_state = 1;  /* xorshift must not start at zero */
+            }
+        } else if (strcmp(argv[i], "--max-ns") == 0 && i + 1 < argc) {
+            max_ns = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (count == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    bench_event_t *events = malloc(count * sizeof(*events));
+    if (events == NULL) {
+        fprintf(stderr, "failed to allocate %zu events\n", count);
+        return 1;
+    }
+
+    printf("%-14s %10s %10s %12s %10s  %s\n", "scenario", "ns/event", "switch ns", "actions", "checksum",
+           "action breakdown");
+
+    uint32_t seed = s_rng_state;
+    int exit_code = 0;
+    for (size_t s = 0; s < s_scenario_count; s++) {
+        bench_result_t result;
+        bench_result_t reference;
+        run_scenario(&s_scenarios[s], logic_process_event, seed, events, count, &result);
+        run_scenario(&s_scenarios[s], logic_process_event_switch, seed, events, count, &reference);
+
+        printf("%-14s %10.2f %10.2f %12llu %10llu ", s_scenarios[s].name, result.ns_per_event, reference.ns_per_event,
+               (unsigned long long)result.actions_emitted,
+               (unsigned long long)(result.checksum % 10000000000ull));
+        for (int bit = 0; bit < ACTION_BIT_COUNT; bit++) {
+            if (result.action_counts[bit] != 0) {
+                printf(" %s=%llu", s_action_names[bit], (unsigned long long)result.action_counts[bit]);
+            }
+        }
+        printf("\n");
+
+        if (result.checksum != reference.checksum || result.actions_emitted != reference.actions_emitted ||
+            !same_state(&result.final_state, &reference.final_state)) {
+            fprintf(stderr, "%s: transition table and switch dispatch disagree\n", s_scenarios[s].name);
+            exit_code = 1;
+        }
+        if (max_ns > 0.0 && result.ns_per_event > max_ns) {
+            fprintf(stderr, "%s: %.2f ns/event exceeds limit of %.2f\n",
+                    s_scenarios[s].name, result.ns_per_event, max_ns);
+            exit_code = 1;
+        }
+    }
+
+    free(events);
+    return exit_code;
+}
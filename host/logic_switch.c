@@ -0,0 +1,338 @@
+/**
+ * The state machine as it was before the transition table: one process_*()
+ * function per state, each switching on the event. Frozen here so that
+ * bench_logic can compare the dispatch cost and check that both versions
+ * produce the same actions. Not built for the device.
+ */
+#include <stddef.h>
+
+#include "logic.h"
+
+uint32_t logic_process_event_switch(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us);
+
+/**
+ * Whole seconds left until deadline_us, rounded up so that zero means the
+ * deadline has been reached
+ */
+static uint32_t remaining_secs(int64_t deadline_us, int64_t now_us) {
+    if (now_us >= deadline_us) {
+        return 0;
+    }
+    return (uint32_t)((deadline_us - now_us + LOGIC_US_PER_SEC - 1) / LOGIC_US_PER_SEC);
+}
+
+/**
+ * Add a brew to the deadline heap (sift up)
+ */
+static void timer_push(app_state_t *state, logic_timer_t timer) {
+    size_t i = state->timer_count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (state->timers[parent].deadline_us <= timer.deadline_us) {
+            break;
+        }
+        state->timers[i] = state->timers[parent];
+        i = parent;
+    }
+    state->timers[i] = timer;
+}
+
+/**
+ * Remove the soonest brew from the deadline heap (sift down)
+ */
+static void timer_pop(app_state_t *state) {
+    logic_timer_t last = state->timers[--state->timer_count];
+    size_t n = state->timer_count;
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && state->timers[child + 1].deadline_us < state->timers[child].deadline_us) {
+            child++;
+        }
+        if (last.deadline_us <= state->timers[child].deadline_us) {
+            break;
+        }
+        state->timers[i] = state->timers[child];
+        i = child;
+    }
+    if (n > 0) {
+        state->timers[i] = last;
+    }
+}
+
+/**
+ * Follow the soonest brew after the heap changed: point deadline_us at it
+ * and show its remaining time
+ */
+static void show_soonest(app_state_t *state, int64_t now_us) {
+    if (state->timer_count > 0) {
+        state->deadline_us = state->timers[0].deadline_us;
+        state->remaining_time_secs = remaining_secs(state->deadline_us, now_us);
+    } else {
+        state->remaining_time_secs = state->target_time_secs;
+    }
+}
+
+/**
+ * Remove every brew whose deadline has passed
+ *
+ * @return Number of brews that ended
+ */
+static uint32_t pop_expired(app_state_t *state, int64_t now_us) {
+    uint32_t expired = 0;
+    while (state->timer_count > 0 && state->timers[0].deadline_us <= now_us) {
+        timer_pop(state);
+        expired++;
+    }
+    if (state->timer_count > 0) {
+        state->deadline_us = state->timers[0].deadline_us;
+    }
+    return expired;
+}
+
+/**
+ * Tick handling shared by every state with brews running. Ended brews raise
+ * the alarm (once), and the tick is re-aimed at the next brew or stopped.
+ */
+static uint32_t handle_tick(app_state_t *state, int64_t now_us) {
+    uint32_t actions = ACTION_NONE;
+
+    if (pop_expired(state, now_us) > 0) {
+        if (state->state != STATE_ALARM) {
+            /* Brew complete - go to alarm */
+            state->state = STATE_ALARM;
+            state->alarm_flash_on = true;
+            state->remaining_time_secs = 0;
+            actions |= ACTION_UPDATE_UI | ACTION_ALARM_START;
+        }
+        actions |= (state->timer_count > 0) ? ACTION_START_TIMER : ACTION_STOP_TIMER;
+        return actions;
+    }
+
+    if (state->state == STATE_RUNNING && state->timer_count > 0) {
+        /* Derive from the clock rather than counting ticks */
+        uint32_t remaining = remaining_secs(state->deadline_us, now_us);
+        if (remaining != state->remaining_time_secs) {
+            state->remaining_time_secs = remaining;
+            actions = ACTION_UPDATE_UI;
+        }
+    }
+    return actions;
+}
+
+/**
+ * Handle encoder input in SETUP state
+ */
+static uint32_t handle_encoder_setup(app_state_t *state, int32_t new_count) {
+    int32_t delta = new_count - state->last_encoder_count;
+    int32_t effective_clicks = delta / LOGIC_ENCODER_DIVISOR;
+
+    if (effective_clicks == 0) {
+        return ACTION_NONE;
+    }
+
+    /* Update last count to account for processed clicks */
+    state->last_encoder_count += effective_clicks * LOGIC_ENCODER_DIVISOR;
+
+    /* Calculate new time */
+    int32_t new_time = (int32_t)state->target_time_secs + (effective_clicks * LOGIC_TIME_STEP_SECS);
+
+    /* Clamp to valid range */
+    if (new_time < LOGIC_MIN_TIME_SECS) {
+        new_time = LOGIC_MIN_TIME_SECS;
+    }
+    if (new_time > LOGIC_MAX_TIME_SECS) {
+        new_time = LOGIC_MAX_TIME_SECS;
+    }
+
+    state->target_time_secs = (uint32_t)new_time;
+    state->remaining_time_secs = state->target_time_secs;
+
+    return ACTION_UPDATE_UI;
+}
+
+/**
+ * Process events in SETUP state
+ */
+static uint32_t process_setup(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    uint32_t actions = ACTION_NONE;
+
+    switch (event) {
+        case EVT_BUTTON_PRESS:
+            if (state->timer_count >= LOGIC_MAX_TIMERS) {
+                break;
+            }
+            /* Start a brew; the tick follows whichever brew ends first */
+            timer_push(state, (logic_timer_t){
+                .deadline_us = now_us + (int64_t)state->target_time_secs * LOGIC_US_PER_SEC,
+                .duration_secs = state->target_time_secs,
+            });
+            state->state = STATE_RUNNING;
+            show_soonest(state, now_us);
+            actions = ACTION_UPDATE_UI | ACTION_START_TIMER;
+            break;
+
+        case EVT_ENCODER_CHANGE:
+            actions = handle_encoder_setup(state, value);
+            break;
+
+        case EVT_TICK_1HZ:
+            /* Brews keep running while another one is dialled in */
+            actions = handle_tick(state, now_us);
+            break;
+
+        case EVT_INACTIVITY_TIMEOUT:
+            if (state->timer_count > 0) {
+                /* Abandoned dialling in another brew, back to the countdown */
+                state->state = STATE_RUNNING;
+                show_soonest(state, now_us);
+                actions = ACTION_UPDATE_UI;
+                break;
+            }
+            /* Go to sleep */
+            state->state = STATE_SLEEP;
+            actions = ACTION_UPDATE_UI | ACTION_BACKLIGHT_OFF | ACTION_SLEEP;
+            break;
+
+        default:
+            break;
+    }
+
+    return actions;
+}
+
+/**
+ * Process events in RUNNING state
+ */
+static uint32_t process_running(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    uint32_t actions = ACTION_NONE;
+
+    switch (event) {
+        case EVT_BUTTON_PRESS:
+            /* Cancel the soonest brew, return to setup if it was the last */
+            timer_pop(state);
+            if (state->timer_count > 0) {
+                show_soonest(state, now_us);
+                actions = ACTION_UPDATE_UI | ACTION_START_TIMER;
+            } else {
+                state->state = STATE_SETUP;
+                state->remaining_time_secs = state->target_time_secs;
+                actions = ACTION_UPDATE_UI | ACTION_STOP_TIMER;
+            }
+            break;
+
+        case EVT_TICK_1HZ:
+            actions = handle_tick(state, now_us);
+            break;
+
+        case EVT_ENCODER_CHANGE:
+            if (state->timer_count >= LOGIC_MAX_TIMERS) {
+                /* No room for another brew: encoder ignored, but update
+                 * last_encoder_count to avoid a jump when returning to SETUP */
+                state->last_encoder_count = value;
+                break;
+            }
+            /* Dial in another brew while this one keeps running */
+            actions = handle_encoder_setup(state, value);
+            if (actions != ACTION_NONE) {
+                state->state = STATE_SETUP;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return actions;
+}
+
+/**
+ * Process events in ALARM state
+ */
+static uint32_t process_alarm(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    uint32_t actions = ACTION_NONE;
+
+    switch (event) {
+        case EVT_BUTTON_PRESS:
+        case EVT_ENCODER_CHANGE:
+            /* Any input stops the alarm, back to the next brew if any */
+            state->state = (state->timer_count > 0) ? STATE_RUNNING : STATE_SETUP;
+            show_soonest(state, now_us);
+            state->alarm_flash_on = false;
+            if (event == EVT_ENCODER_CHANGE) {
+                /* Button events carry no count; keep the baseline */
+                state->last_encoder_count = value;
+            }
+            /* Explicitly turn backlight on - buzzer LEDC can interfere */
+            actions = ACTION_UPDATE_UI | ACTION_ALARM_STOP | ACTION_BACKLIGHT_ON;
+            break;
+
+        case EVT_TICK_1HZ:
+            /* Other brews ending now just join the alarm already ringing */
+            actions = handle_tick(state, now_us);
+            break;
+
+        case EVT_TICK_FAST:
+            /* Toggle flash state */
+            state->alarm_flash_on = !state->alarm_flash_on;
+            actions = ACTION_TOGGLE_FLASH;
+            break;
+
+        default:
+            break;
+    }
+
+    return actions;
+}
+
+/**
+ * Process events in SLEEP state
+ */
+static uint32_t process_sleep(app_state_t *state, logic_event_t event, int32_t value) {
+    uint32_t actions = ACTION_NONE;
+
+    switch (event) {
+        case EVT_BUTTON_PRESS:
+        case EVT_ENCODER_CHANGE:
+            /* Any input wakes up */
+            state->state = STATE_SETUP;
+            if (event == EVT_ENCODER_CHANGE) {
+                /* Button events carry no count; keep the baseline */
+                state->last_encoder_count = value;
+            }
+            actions = ACTION_UPDATE_UI | ACTION_BACKLIGHT_ON;
+            break;
+
+        case EVT_INACTIVITY_TIMEOUT:
+            /* Woken without a usable input (e.g. a press that was not a click) */
+            actions = ACTION_SLEEP;
+            break;
+
+        default:
+            break;
+    }
+
+    return actions;
+}
+
+uint32_t logic_process_event_switch(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us) {
+    switch (state->state) {
+        case STATE_SETUP:
+            return process_setup(state, event, event_value, now_us);
+
+        case STATE_RUNNING:
+            return process_running(state, event, event_value, now_us);
+
+        case STATE_ALARM:
+            return process_alarm(state, event, event_value, now_us);
+
+        case STATE_SLEEP:
+            return process_sleep(state, event, event_value);
+
+        default:
+            return ACTION_NONE;
+    }
+}
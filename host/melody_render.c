@@ -0,0 +1,233 @@
+/**
+ * Host renderer for the buzzer melodies.
+ *
+ * Walks the melody tables from main/melody.c with the same sequencer the
+ * device uses and prints the resulting steps. Each note's start is checked
+ * against the onset computed straight from the table, and the total length
+ * against melody_duration_ms(). With -o the melody is also rendered to a
+ * mono 16-bit WAV file as the PWM waveform the buzzer pin would carry,
+ * including the duty envelope, with every step placed at its absolute
+ * sample offset.
+ *
+ * Usage: melody_render [-m melody] [-r sample_rate] [-o out.wav] [-q]
+ *
+ * Without -m every melody is checked. Exits non-zero on a timing mismatch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "melody.h"
+
+#define DEFAULT_SAMPLE_RATE 48000u
+
+/* Duty at which the buzzer is driven hardest, as on the device */
+#define FULL_DUTY 0.5
+
+/**
+ * Duty at a point in a step, following the linear decay
+ */
+static double step_duty(const melody_step_t *step, uint32_t t_ms_x1000) {
+    double peak = FULL_DUTY * step->peak_pct / 100.0;
+    double sustain = FULL_DUTY * step->sustain_pct / 100.0;
+    if (step->decay_ms == 0 || t_ms_x1000 >= (uint32_t)step->decay_ms * 1000) {
+        return (step->decay_ms == 0) ? peak : sustain;
+    }
+    return peak + (sustain - peak) * t_ms_x1000 / (step->decay_ms * 1000.0);
+}
+
+static void put_le16(FILE *f, uint16_t v) {
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void put_le32(FILE *f, uint32_t v) {
+    put_le16(f, v & 0xFFFF);
+    put_le16(f, v >> 16);
+}
+
+/**
+ * Write the melody as a 16-bit mono PCM WAV file
+ */
+static int render_wav(const melody_t *melody, uint32_t rate, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    uint32_t samples = (uint32_t)((uint64_t)melody_duration_ms(melody) * rate / 1000);
+    fwrite("RIFF", 1, 4, f);
+    put_le32(f, 36 + samples * 2);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_le32(f, 16);
+    put_le16(f, 1);          /* PCM */
+    put_le16(f, 1);          /* Mono */
+    put_le32(f, rate);
+    put_le32(f, rate * 2);
+    put_le16(f, 2);
+    put_le16(f, 16);
+    fwrite("data", 1, 4, f);
+    put_le32(f, samples * 2);
+
+    melody_cursor_t cursor;
+    melody_step_t step;
+    melody_start(&cursor, melody);
+    double phase = 0.0;
+    uint32_t n = 0;
+    while (melody_next(&cursor, &step)) {
+        /* Step boundaries come from the absolute offsets, never from a sum
+         * of rounded per-step sample counts */
+        uint32_t first = (uint32_t)((uint64_t)step.start_ms * rate / 1000);
+        uint32_t end = (uint32_t)((uint64_t)(step.start_ms + step.duration_ms) * rate / 1000);
+        for (n = first; n < end; n++) {
+            int16_t sample = 0;
+            if (step.freq_hz != MELODY_REST) {
+                uint32_t t_ms_x1000 = (uint32_t)((uint64_t)(n - first) * 1000000 / rate);
+                double duty = step_duty(&step, t_ms_x1000);
+                /* Zero-mean pulse, so silence and the duty change the level */
+                double level = (phase < duty ? 1.0 : 0.0) - duty;
+                sample = (int16_t)(level * 32767.0);
+                phase += (double)step.freq_hz / rate;
+                phase -= (int)phase;
+            }
+            put_le16(f, (uint16_t)sample);
+        }
+    }
+    for (; n < samples; n++) {
+        put_le16(f, 0);
+    }
+
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    printf("wrote %s: %u samples at %u Hz\n", path, samples, rate);
+    return 0;
+}
+
+/**
+ * Print the steps of a melody and check their timing against the table
+ *
+ * @return Number of timing errors
+ */
+static int check_melody(const melody_t *melody, bool quiet) {
+    int errors = 0;
+    uint32_t steps = 0;
+    uint32_t notes = 0;
+
+    /* Note onsets straight from the table */
+    uint32_t expected_ms = 0;
+    uint8_t plays = melody->plays > 0 ? melody->plays : 1;
+    uint32_t onset_ms[256];
+    uint32_t onset_count = 0;
+    for (uint8_t p = 0; p < plays; p++) {
+        for (size_t i = 0; i < melody->note_count; i++) {
+            if (melody->notes[i].freq_hz != MELODY_REST && onset_count < 256) {
+                onset_ms[onset_count++] = expected_ms;
+            }
+            expected_ms += melody->notes[i].duration_ms;
+        }
+        if (p + 1 < plays) {
+            expected_ms += melody->gap_ms;
+        }
+    }
+
+    printf("%s: %u ms, %u plays\n", melody->name, melody_duration_ms(melody), plays);
+    melody_cursor_t cursor;
+    melody_step_t step;
+    uint32_t end_ms = 0;
+    melody_start(&cursor, melody);
+    while (melody_next(&cursor, &step)) {
+        if (!quiet) {
+            if (step.freq_hz == MELODY_REST) {
+                printf("  %6u ms %5u ms  rest\n", step.start_ms, step.duration_ms);
+            } else {
+                printf("  %6u ms %5u ms  %5u Hz  level %3u%%", step.start_ms, step.duration_ms,
+                       step.freq_hz, step.peak_pct);
+                if (step.decay_ms > 0) {
+                    printf(" -> %3u%% in %u ms", step.sustain_pct, step.decay_ms);
+                }
+                printf("\n");
+            }
+        }
+        if (step.start_ms != end_ms) {
+            printf("  step %u starts at %u ms, previous ended at %u ms\n", steps, step.start_ms, end_ms);
+            errors++;
+        }
+        if (step.freq_hz != MELODY_REST) {
+            if (notes >= onset_count || onset_ms[notes] != step.start_ms) {
+                printf("  note %u starts at %u ms, table says %u ms\n", notes, step.start_ms,
+                       notes < onset_count ? onset_ms[notes] : 0);
+                errors++;
+            }
+            notes++;
+        }
+        end_ms = step.start_ms + step.duration_ms;
+        steps++;
+    }
+
+    if (notes != onset_count || end_ms != expected_ms || end_ms != melody_duration_ms(melody)) {
+        printf("  %u of %u notes, ends at %u ms, table says %u ms\n", notes, onset_count, end_ms, expected_ms);
+        errors++;
+    }
+    printf("  %u steps (timer wakeups), %u notes, %s\n", steps, notes, errors ? "TIMING ERROR" : "timing ok");
+    return errors;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-m melody] [-r sample_rate] [-o out.wav] [-q]\n", prog);
+    fprintf(stderr, "melodies:");
+    for (int i = 0; i < MELODY_COUNT; i++) {
+        fprintf(stderr, " %s", melody_get((melody_id_t)i)->name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    const char *melody_name = NULL;
+    const char *wav_path = NULL;
+    uint32_t rate = DEFAULT_SAMPLE_RATE;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            melody_name = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rate = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            wav_path = argv[++i];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    const melody_t *selected = NULL;
+    if (melody_name != NULL) {
+        for (int i = 0; i < MELODY_COUNT; i++) {
+            if (strcmp(melody_get((melody_id_t)i)->name, melody_name) == 0) {
+                selected = melody_get((melody_id_t)i);
+            }
+        }
+    }
+    if ((melody_name != NULL && selected == NULL) || (wav_path != NULL && selected == NULL) ||
+        rate < 8000 || rate > 192000) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int errors = 0;
+    for (int i = 0; i < MELODY_COUNT; i++) {
+        const melody_t *melody = melody_get((melody_id_t)i);
+        if (selected == NULL || selected == melody) {
+            errors += check_melody(melody, quiet);
+        }
+    }
+    if (wav_path != NULL && render_wav(selected, rate, wav_path) != 0) {
+        return 1;
+    }
+    return errors ? 1 : 0;
+}
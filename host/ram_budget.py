@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""
+Per-component RAM report from the linker map of a device build.
+
+Sums the static RAM every component (static library) places in internal
+memory: initialized data, zero-initialized data and IRAM code, which shares
+the internal SRAM on the ESP32-S3. Heap use is not in the map; the device
+logs it at the end of boot ("Heap after boot").
+
+Budgets are read from ram_budget.txt at the top of the repository, one
+"component bytes" pair per line, and apply to data + bss. Components
+without a budget are only listed. Exits non-zero if a budget is exceeded.
+Several maps can be given, e.g. the default and the zero-heap build, and
+each is checked.
+
+Usage: ram_budget.py [--budget file] [--objects] [--write margin] map...
+
+With --objects, the main component is broken down per source file. With
+--write, the budgets in the file are replaced by what the maps measure (the
+largest of them) plus margin percent, rounded up to 256 bytes, and the
+measurement is recorded in the file's "measured" comment lines.
+"""
+import argparse
+import os
+import re
+import sys
+
+KINDS = ("data", "bss", "iram")
+
+# Input section name prefixes and the kind of RAM they occupy
+SECTION_KINDS = (
+    (".dram", "data"),
+    (".data", "data"),
+    (".sdata", "data"),
+    (".rodata_in_dram", "data"),
+    (".bss", "bss"),
+    (".sbss", "bss"),
+    (".noinit", "bss"),
+    ("COMMON", "bss"),
+    (".iram", "iram"),
+)
+
+# "<section> 0x<addr> 0x<size> <archive>(<object>)", where the section name
+# may stand on a line of its own with the rest on the next
+ENTRY = re.compile(r"^\s*0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*)$")
+SECTION = re.compile(r"^ (\S+)(.*)$")
+ARCHIVE = re.compile(r"(?:^|/)lib([^/()]+)\.a\((.+)\)$")
+
+# Budgets are rounded up to this
+BUDGET_ROUND = 256
+
+DEFAULT_BUDGET = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "ram_budget.txt")
+
+
+def section_kind(name):
+    for prefix, kind in SECTION_KINDS:
+        if name.startswith(prefix):
+            return kind
+    return None
+
+
+def parse_map(lines):
+    """Yield (kind, size, component, object) for every input section in RAM"""
+    in_map = False
+    pending = None
+    for line in lines:
+        if not in_map:
+            in_map = line.startswith("Linker script and memory map")
+            continue
+        if pending is not None:
+            m = ENTRY.match(line)
+            name, pending = pending, None
+            if m:
+                yield from classify(name, int(m.group(1), 16), m.group(2))
+                continue
+        m = SECTION.match(line)
+        if not m:
+            continue
+        name, rest = m.group(1), m.group(2)
+        if not rest.strip():
+            pending = name
+            continue
+        m = ENTRY.match(rest)
+        if m:
+            yield from classify(name, int(m.group(1), 16), m.group(2))
+
+
+def classify(name, size, source):
+    kind = section_kind(name)
+    if kind is None or size == 0:
+        return
+    m = ARCHIVE.search(source.strip())
+    if m:
+        yield kind, size, m.group(1), m.group(2)
+    else:
+        yield kind, size, "(other)", os.path.basename(source.strip())
+
+
+def read_budget(path):
+    budget = {}
+    if not os.path.exists(path):
+        return budget
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            try:
+                component, size = line.split()
+                budget[component] = int(size, 0)
+            except ValueError:
+                sys.exit(f"{path}:{n}: expected 'component bytes'")
+    return budget
+
+
+def write_budget(path, measured, sources, margin):
+    """Replace each budget with the measured size plus margin percent"""
+    with open(path) as f:
+        lines = f.readlines()
+    out = []
+    for line in lines:
+        words = line.split("#", 1)[0].split()
+        if line.startswith("# measured "):
+            continue
+        if len(words) == 2 and words[0] in measured:
+            limit = -(-measured[words[0]] * (100 + margin) // 100 // BUDGET_ROUND) * BUDGET_ROUND
+            line = f"{words[0]:<12}{limit}\n"
+        out.append(line)
+    notes = [f"# measured {name} {used} bytes, budget +{margin}%\n" for name, used in sorted(measured.items())]
+    notes.append(f"# measured from {', '.join(sources)}\n")
+    first = next((i for i, line in enumerate(out) if not line.startswith("#")), len(out))
+    out[first:first] = notes
+    with open(path, "w") as f:
+        f.writelines(out)
+
+
+def print_table(title, totals, budget):
+    over = []
+    print(f"{title:<28} {'data':>8} {'bss':>8} {'iram':>8} {'budget':>8}")
+    for name, sizes in sorted(totals.items(), key=lambda kv: -(kv[1]["data"] + kv[1]["bss"])):
+        used = sizes["data"] + sizes["bss"]
+        limit = budget.get(name)
+        mark = ""
+        if limit is not None:
+            mark = f"{limit:>8}" + ("  OVER" if used > limit else "")
+            if used > limit:
+                over.append(name)
+        print(f"{name:<28} {sizes['data']:>8} {sizes['bss']:>8} {sizes['iram']:>8} {mark}")
+    total = {k: sum(s[k] for s in totals.values()) for k in KINDS}
+    print(f"{'total':<28} {total['data']:>8} {total['bss']:>8} {total['iram']:>8}")
+    return over
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("maps", nargs="+", metavar="map", help="linker map, e.g. build/tea_timer.map")
+    parser.add_argument("--budget", default=DEFAULT_BUDGET, help="budget file")
+    parser.add_argument("--objects", action="store_true", help="break main down per source file")
+    parser.add_argument("--write", type=int, metavar="margin",
+                        help="set the budgets from the maps plus this many percent")
+    args = parser.parse_args()
+
+    budget = read_budget(args.budget)
+    measured = {}
+    over = []
+    for n, path in enumerate(args.maps):
+        components = {}
+        objects = {}
+        with open(path) as f:
+            for kind, size, component, obj in parse_map(f):
+                components.setdefault(component, dict.fromkeys(KINDS, 0))[kind] += size
+                if component == "main":
+                    objects.setdefault(obj, dict.fromkeys(KINDS, 0))[kind] += size
+
+        if not components:
+            sys.exit(f"{path}: no RAM sections found, is this a GNU ld map file?")
+
+        if n > 0:
+            print()
+        if len(args.maps) > 1:
+            print(path)
+        over += [f"{name} ({path})" for name in print_table("component", components, budget)]
+        if args.objects and objects:
+            print()
+            print_table("main", objects, {})
+        for name in budget:
+            if name in components:
+                used = components[name]["data"] + components[name]["bss"]
+                measured[name] = max(measured.get(name, 0), used)
+
+    if args.write is not None:
+        write_budget(args.budget, measured, args.maps, args.write)
+        print(f"\nwrote {args.budget}")
+        return 0
+    if over:
+        print(f"\nover budget: {', '.join(over)}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,253 @@
+/**
+ * Replays an input recording (main/recorder.h) through the state machine.
+ *
+ * Reads a serial log, or a tea_sim -r file, and takes the last complete
+ * recorder dump in it. Starting from the recorded base state, every event is
+ * fed to logic_process_event() with its recorded time, and the actions and
+ * resulting state are compared with what the device produced. Reports the
+ * processing time per event type and every divergence.
+ *
+ * Usage: replay [-x speed] [-v] [log]
+ *
+ * By default events are replayed as fast as possible. With -x they are
+ * paced by their recorded timestamps: -x 1 is the original speed, -x 60
+ * plays a minute per second. Exits non-zero if the replay diverged.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logic.h"
+#include "recorder.h"
+
+/* Divergences printed in full before only counting */
+#define MAX_REPORTED 10
+
+static const char *s_event_names[EVT_COUNT] = {
+    "NONE", "BUTTON_PRESS", "ENCODER_CHANGE", "TICK_1HZ", "TICK_FAST", "INACTIVITY",
+};
+
+typedef struct {
+    uint32_t count;
+    uint64_t ns_total;
+    uint64_t ns_max;
+} replay_stats_t;
+
+/* Last complete dump found in the input */
+typedef struct {
+    app_state_t base;
+    recorder_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    uint32_t overwritten;
+} recording_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline) {
+    uint64_t now = now_ns();
+    if (deadline > now) {
+        uint64_t delta = deadline - now;
+        struct timespec ts = { .tv_sec = (time_t)(delta / 1000000000u), .tv_nsec = (long)(delta % 1000000000u) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+/**
+ * Parse a "base" line into state
+ */
+static bool parse_base(const char *text, app_state_t *state) {
+    int st, flash, used;
+    unsigned count;
+    logic_init(state);
+    if (sscanf(text, "%d %" SCNu32 " %" SCNu32 " %" SCNd64 " %" SCNd32 " %d %u%n", &st,
+               &state->target_time_secs, &state->remaining_time_secs, &state->deadline_us,
+               &state->last_encoder_count, &flash, &count, &used) != 7 ||
+        st < 0 || st >= STATE_COUNT || count > LOGIC_MAX_TIMERS) {
+        return false;
+    }
+    state->state = (tea_state_t)st;
+    state->alarm_flash_on = flash != 0;
+    state->timer_count = (uint8_t)count;
+    text += used;
+    for (unsigned i = 0; i < count; i++) {
+        if (sscanf(text, " %" SCNd64 " %" SCNu32 "%n", &state->timers[i].deadline_us,
+                   &state->timers[i].duration_secs, &used) != 2) {
+            return false;
+        }
+        text += used;
+    }
+    return true;
+}
+
+/**
+ * Read the last complete dump from a log
+ */
+static bool read_recording(FILE *f, recording_t *rec) {
+    char line[512];
+    bool in_dump = false;
+    bool complete = false;
+    recording_t cur = {0};
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const char *p = strstr(line, RECORDER_LINE_PREFIX);
+        if (p == NULL) {
+            continue;
+        }
+        p += strlen(RECORDER_LINE_PREFIX);
+
+        int format;
+        unsigned count;
+        if (sscanf(p, "begin %d %u %" SCNu32, &format, &count, &cur.overwritten) == 3) {
+            in_dump = format == RECORDER_FORMAT;
+            cur.count = 0;
+            if (!in_dump) {
+                fprintf(stderr, "skipping dump in format %d\n", format);
+            }
+        } else if (!in_dump) {
+            continue;
+        } else if (strncmp(p, "base ", 5) == 0) {
+            if (!parse_base(p + 5, &cur.base)) {
+                fprintf(stderr, "bad base line: %s", line);
+                in_dump = false;
+            }
+        } else if (strncmp(p, "ev ", 3) == 0) {
+            recorder_entry_t e;
+            unsigned event, actions, state;
+            if (sscanf(p + 3, "%" SCNd64 " %u %" SCNd32 " %u %u", &e.now_us, &event, &e.value, &actions, &state) != 5 ||
+                event >= EVT_COUNT || state >= STATE_COUNT) {
+                fprintf(stderr, "bad event line: %s", line);
+                in_dump = false;
+                continue;
+            }
+            e.event = (uint8_t)event;
+            e.actions = (uint16_t)actions;
+            e.state_after = (uint8_t)state;
+            if (cur.count == cur.capacity) {
+                cur.capacity = cur.capacity ? cur.capacity * 2 : RECORDER_CAPACITY;
+                cur.entries = realloc(cur.entries, cur.capacity * sizeof(*cur.entries));
+                if (cur.entries == NULL) {
+                    fprintf(stderr, "out of memory\n");
+                    exit(1);
+                }
+            }
+            cur.entries[cur.count++] = e;
+        } else if (sscanf(p, "end %u", &count) == 1) {
+            if (count == cur.count) {
+                /* Keep this one unless a later dump completes */
+                free(rec->entries);
+                *rec = cur;
+                complete = true;
+                cur = (recording_t){0};
+            } else {
+                fprintf(stderr, "incomplete dump: %zu of %u events\n", cur.count, count);
+            }
+            in_dump = false;
+        }
+    }
+    free(cur.entries);
+    return complete;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-x speed] [-v] [log]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    double speed = 0.0;
+    bool verbose = false;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            speed = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (speed < 0.0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *f = stdin;
+    if (path != NULL && (f = fopen(path, "r")) == NULL) {
+        perror(path);
+        return 2;
+    }
+    recording_t rec = {0};
+    bool found = read_recording(f, &rec);
+    if (f != stdin) {
+        fclose(f);
+    }
+    if (!found) {
+        fprintf(stderr, "no complete recorder dump found\n");
+        return 2;
+    }
+
+    printf("replaying %zu events (%" PRIu32 " older ones overwritten on the device)\n", rec.count, rec.overwritten);
+
+    app_state_t state = rec.base;
+    replay_stats_t stats[EVT_COUNT] = {0};
+    uint32_t divergences = 0;
+    uint64_t wall_start = now_ns();
+    int64_t first_us = rec.count > 0 ? rec.entries[0].now_us : 0;
+
+    for (size_t i = 0; i < rec.count; i++) {
+        const recorder_entry_t *e = &rec.entries[i];
+        if (speed > 0.0) {
+            sleep_until_ns(wall_start + (uint64_t)((double)(e->now_us - first_us) * 1000.0 / speed));
+        }
+
+        tea_state_t before = state.state;
+        uint64_t start = now_ns();
+        uint32_t actions = logic_process_event(&state, (logic_event_t)e->event, e->value, e->now_us);
+        uint64_t elapsed = now_ns() - start;
+
+        replay_stats_t *st = &stats[e->event];
+        st->count++;
+        st->ns_total += elapsed;
+        if (elapsed > st->ns_max) {
+            st->ns_max = elapsed;
+        }
+
+        bool diverged = actions != e->actions || state.state != e->state_after;
+        if (verbose || (diverged && divergences < MAX_REPORTED)) {
+            printf("%s%6zu %12.6f s %-15s %6" PRId32 "  state %d -> %d  actions 0x%03" PRIx32,
+                   diverged ? "DIVERGED " : "", i, (double)e->now_us / 1e6, s_event_names[e->event],
+                   e->value, before, state.state, actions);
+            if (diverged) {
+                printf("  (recorded state %u, actions 0x%03x)", e->state_after, e->actions);
+            }
+            printf("\n");
+        }
+        if (diverged) {
+            divergences++;
+            /* Follow the device from here on, so one difference is reported once */
+            state.state = (tea_state_t)e->state_after;
+        }
+    }
+
+    printf("\n%-16s %8s %12s %12s\n", "event", "count", "avg ns", "max ns");
+    for (int t = 0; t < EVT_COUNT; t++) {
+        if (stats[t].count > 0) {
+            printf("%-16s %8u %12.0f %12llu\n", s_event_names[t], stats[t].count,
+                   (double)stats[t].ns_total / stats[t].count, (unsigned long long)stats[t].ns_max);
+        }
+    }
+    printf("\n%u divergences, final state %d\n", divergences, state.state);
+
+    free(rec.entries);
+    return divergences ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+/**
+ * Host stand-in for the M5Dial BSP, for view_render: the display lock is a
+ * no-op, as the renderer is single-threaded.
+ */
+#ifndef SHIM_ESP_BSP_H
+#define SHIM_ESP_BSP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BSP_LCD_H_RES 240
+#define BSP_LCD_V_RES 240
+
+static inline bool bsp_display_lock(uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return true;
+}
+
+static inline void bsp_display_unlock(void) {
+}
+
+#endif /* SHIM_ESP_BSP_H */
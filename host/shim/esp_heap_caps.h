@@ -0,0 +1,19 @@
+/**
+ * Host stand-in for esp_heap_caps.h, for view_render: capabilities are
+ * ignored.
+ */
+#ifndef SHIM_ESP_HEAP_CAPS_H
+#define SHIM_ESP_HEAP_CAPS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    (void)caps;
+    return calloc(n, size);
+}
+
+#endif /* SHIM_ESP_HEAP_CAPS_H */
@@ -0,0 +1,14 @@
+/**
+ * Host stand-in for esp_log.h, for view_render: errors and warnings go to
+ * stderr, info is dropped so it does not mix with the report.
+ */
+#ifndef SHIM_ESP_LOG_H
+#define SHIM_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif /* SHIM_ESP_LOG_H */
@@ -0,0 +1,14 @@
+/**
+ * Host stand-in for esp_timer.h, for view_render (see view_render.c)
+ */
+#ifndef SHIM_ESP_TIMER_H
+#define SHIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+/**
+ * Monotonic time in microseconds
+ */
+int64_t esp_timer_get_time(void);
+
+#endif /* SHIM_ESP_TIMER_H */
@@ -0,0 +1,23 @@
+/**
+ * LVGL configuration for view_render. Mirrors what the device build sets in
+ * sdkconfig.defaults on top of the LVGL defaults: RGB565, the fonts view.c
+ * uses, the canvas and L8 rendering for the glyph atlas.
+ */
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#define LV_COLOR_DEPTH          16
+#define LV_USE_OS               LV_OS_NONE
+#define LV_USE_STDLIB_MALLOC    LV_STDLIB_BUILTIN
+#define LV_MEM_SIZE             (256 * 1024)
+
+#define LV_FONT_MONTSERRAT_14   1
+#define LV_FONT_MONTSERRAT_48   1
+#define LV_FONT_DEFAULT         &lv_font_montserrat_14
+
+#define LV_USE_CANVAS           1
+#define LV_DRAW_SW_SUPPORT_L8   1
+
+#define LV_USE_LOG              0
+
+#endif /* LV_CONF_H */
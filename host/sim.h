@@ -0,0 +1,131 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "app_event.h"
+
+/*
+ * Linux simulator for the application event loop.
+ *
+ * sim_hal.c implements hal.h on a virtual clock: time only moves when the
+ * loop waits for an event, and then jumps straight to the next timer expiry
+ * or scripted input. A 10 minute brew runs in a few milliseconds of wall
+ * time while exercising the unmodified app_main() from main/tea_timer.c.
+ * Events go through the same event bus (main/event_bus.c) as on the device.
+ */
+
+#define SIM_EVENT_TYPE_COUNT (EVENT_SETTINGS_SAVE + 1)
+#define SIM_MAX_ALARMS       8
+
+/**
+ * Per event type statistics
+ */
+typedef struct {
+    uint32_t received;
+    uint64_t processing_ns_total;  /* Wall time spent in the loop body */
+    uint64_t processing_ns_max;
+} sim_event_stats_t;
+
+/**
+ * Simulation statistics
+ */
+typedef struct {
+    sim_event_stats_t events[SIM_EVENT_TYPE_COUNT];
+    uint32_t events_dropped;
+    uint32_t timer_fires;
+    uint32_t display_locks;
+    uint32_t sleeps;               /* hal_sleep_until_input() calls */
+    uint32_t refreshes_now;        /* hal_display_refresh_now() calls */
+    uint32_t trace_lines;          /* Trace lines flushed */
+    uint32_t storage_writes;       /* hal_storage_save() calls */
+    uint32_t alarm_count;          /* Buzzer starts */
+    int64_t alarm_us[SIM_MAX_ALARMS];  /* Virtual times of the first buzzer starts */
+    int64_t end_us;                /* Virtual time when the simulation ended */
+} sim_stats_t;
+
+/**
+ * Last rendered view, recorded by the view stub
+ */
+typedef struct {
+    int state;                     /* view_state_t */
+    uint32_t time_secs;
+    int8_t tenths;
+    uint8_t progress;
+    uint8_t other_timers;
+    uint8_t other_timers_max;      /* Most brews ever shown as running in the background */
+    bool alarm_flash_on;
+    bool backlight_on;
+    uint32_t updates;
+    uint32_t tenths_updates;       /* Updates that showed tenths */
+    uint32_t kicks;                /* Renderer wakes by view_post() */
+    uint32_t flash_toggles;
+} sim_view_t;
+
+/**
+ * Reset the virtual clock, script, storage and statistics.
+ */
+void sim_reset(void);
+
+/**
+ * Print informational log lines from the application (default: off).
+ */
+void sim_set_verbose(bool verbose);
+
+/**
+ * Stop the simulation at this virtual time even if timers are still armed.
+ */
+void sim_set_end_time(int64_t end_us);
+
+/**
+ * Write flushed trace lines (see main/trace.h) to file, or discard them if
+ * NULL (the default).
+ */
+void sim_set_trace_file(FILE *file);
+
+/**
+ * Reject every n-th EVENT_TICK_1HZ post as if the ring were full, to check
+ * that the countdown still ends on time (0 = never, the default).
+ */
+void sim_set_tick_drop(uint32_t every_n);
+
+/**
+ * Script a faceplate button click at a virtual time.
+ */
+void sim_schedule_button(int64_t at_us);
+
+/**
+ * Script an encoder turn of the given number of detents (negative turns
+ * counter-clockwise) at a virtual time.
+ */
+void sim_schedule_encoder(int64_t at_us, int32_t detents);
+
+/**
+ * Drive the application from a pty console instead of the script (see
+ * sim_console.c). The pty is opened by hal_console_start(). Virtual time
+ * then stands still until an ff command moves it.
+ */
+void sim_set_console(bool enabled);
+
+/**
+ * pty console, used by sim_hal.c: open it, and read and run one command
+ * line. sim_console_poll() returns false on quit or when the pty fails.
+ */
+bool sim_console_open(void);
+bool sim_console_is_open(void);
+bool sim_console_poll(void);
+void sim_console_close(void);
+
+/**
+ * Statistics collected so far.
+ */
+const sim_stats_t *sim_get_stats(void);
+
+/**
+ * View state as last rendered by the application.
+ */
+sim_view_t *sim_get_view(void);
+
+#endif /* SIM_H */
@@ -0,0 +1,113 @@
+/**
+ * Stand-in for the device console (main/console.h) on a pseudo terminal.
+ *
+ * tea_sim -c opens a pty and prints the path of its terminal side; connect
+ * to it with e.g. `socat - /dev/pts/5,raw,echo=0`. Whenever the application
+ * has nothing to do, the simulator reads one command line from the pty and
+ * runs it through the same command table as the device. Virtual time only
+ * moves with the ff command.
+ */
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "console.h"
+
+#define CONSOLE_PROMPT    "tea> "
+#define CONSOLE_LINE_MAX  128
+
+static int s_master = -1;
+static int s_slave = -1;    /* Held open so reads wait for a client rather than fail */
+static FILE *s_out = NULL;
+
+bool sim_console_open(void) {
+    s_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (s_master < 0 || grantpt(s_master) != 0 || unlockpt(s_master) != 0) {
+        perror("sim console");
+        return false;
+    }
+    const char *name = ptsname(s_master);
+    s_slave = name != NULL ? open(name, O_RDWR | O_NOCTTY) : -1;
+    s_out = fdopen(dup(s_master), "w");
+    if (s_slave < 0 || s_out == NULL) {
+        perror("sim console");
+        return false;
+    }
+
+    /* Raw, so our own output is not echoed back to us as input */
+    struct termios tio;
+    if (tcgetattr(s_slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(s_slave, TCSANOW, &tio);
+    }
+    fprintf(stderr, "console on %s\n", name);
+    return true;
+}
+
+bool sim_console_is_open(void) {
+    return s_out != NULL;
+}
+
+/**
+ * Read one line, ending in CR or LF, from the pty
+ */
+static bool read_line(char *line, size_t size) {
+    size_t len = 0;
+    for (;;) {
+        char c;
+        ssize_t n = read(s_master, &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        if (c == '\r' || c == '\n') {
+            if (len == 0) {
+                continue;
+            }
+            line[len] = '\0';
+            return true;
+        }
+        if (len + 1 < size) {
+            line[len++] = c;
+        }
+    }
+}
+
+bool sim_console_poll(void) {
+    char line[CONSOLE_LINE_MAX];
+    fprintf(s_out, CONSOLE_PROMPT);
+    fflush(s_out);
+    if (!read_line(line, sizeof(line))) {
+        return false;
+    }
+    if (strcmp(line, "quit") == 0) {
+        return false;
+    }
+    console_execute(s_out, line);
+    fflush(s_out);
+    return true;
+}
+
+void sim_console_close(void) {
+    if (s_out != NULL) {
+        fclose(s_out);
+        s_out = NULL;
+    }
+    if (s_slave >= 0) {
+        close(s_slave);
+        s_slave = -1;
+    }
+    if (s_master >= 0) {
+        close(s_master);
+        s_master = -1;
+    }
+}
@@ -0,0 +1,508 @@
+/**
+ * hal.h implementation for the Linux simulator, driven by a virtual clock.
+ */
+#include "hal.h"
+#include "sim.h"
+#include "logic.h"
+#include "event_bus.h"
+#include "trace.h"
+#include "latency.h"
+#include "view.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_MAX_TIMERS      16
+#define SIM_MAX_INPUTS      256
+#define SIM_STORAGE_SIZE    64
+
+struct hal_timer {
+    const char *name;
+    hal_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    int64_t deadline_us;
+    uint64_t period_us;  /* 0 for one-shot */
+    uint32_t fires;
+};
+
+typedef enum {
+    SIM_INPUT_BUTTON,
+    SIM_INPUT_ENCODER,
+} sim_input_type_t;
+
+typedef struct {
+    int64_t at_us;
+    sim_input_type_t type;
+    int32_t detents;
+} sim_input_t;
+
+static int64_t s_now_us = 0;
+static int64_t s_end_us = INT64_MAX;
+static bool s_verbose = false;
+static bool s_console = false;
+
+static struct hal_timer s_timers[SIM_MAX_TIMERS];
+static size_t s_timer_count = 0;
+
+static sim_input_t s_inputs[SIM_MAX_INPUTS];
+static size_t s_input_count = 0;
+static size_t s_input_next = 0;
+
+static int32_t s_encoder_count = 0;
+
+static uint32_t s_tick_drop_every = 0;
+static uint32_t s_tick_posts = 0;
+
+/* Wall-clock accounting of the loop body between two receives */
+static bool s_in_event = false;
+static event_type_t s_current_type = EVENT_NONE;
+static uint64_t s_receive_ns = 0;
+
+/* Trace lines go here when set, otherwise they are discarded */
+static FILE *s_trace_file = NULL;
+
+static sim_stats_t s_stats;
+static sim_view_t s_view;
+
+/* Settings record, standing in for NVS */
+static uint8_t s_storage[SIM_STORAGE_SIZE];
+static size_t s_storage_size = 0;
+
+static uint64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void sim_reset(void) {
+    s_now_us = 0;
+    s_end_us = INT64_MAX;
+    s_timer_count = 0;
+    s_input_count = 0;
+    s_input_next = 0;
+    event_bus_init();
+    s_encoder_count = 0;
+    s_tick_drop_every = 0;
+    s_tick_posts = 0;
+    s_in_event = false;
+    s_storage_size = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(&s_view, 0, sizeof(s_view));
+}
+
+void sim_set_verbose(bool verbose) {
+    s_verbose = verbose;
+}
+
+void sim_set_end_time(int64_t end_us) {
+    s_end_us = end_us;
+}
+
+void sim_set_console(bool enabled) {
+    s_console = enabled;
+    s_end_us = enabled ? s_now_us : INT64_MAX;
+}
+
+void sim_set_trace_file(FILE *file) {
+    s_trace_file = file;
+}
+
+void sim_set_tick_drop(uint32_t every_n) {
+    s_tick_drop_every = every_n;
+}
+
+static void schedule_input(sim_input_t input) {
+    if (s_input_count >= SIM_MAX_INPUTS) {
+        fprintf(stderr, "sim: input script full\n");
+        abort();
+    }
+    /* Keep the script sorted by time, stable for equal times */
+    size_t i = s_input_count++;
+    while (i > s_input_next && s_inputs[i - 1].at_us > input.at_us) {
+        s_inputs[i] = s_inputs[i - 1];
+        i--;
+    }
+    s_inputs[i] = input;
+}
+
+void sim_schedule_button(int64_t at_us) {
+    schedule_input((sim_input_t){ .at_us = at_us, .type = SIM_INPUT_BUTTON });
+}
+
+void sim_schedule_encoder(int64_t at_us, int32_t detents) {
+    schedule_input((sim_input_t){ .at_us = at_us, .type = SIM_INPUT_ENCODER, .detents = detents });
+}
+
+const sim_stats_t *sim_get_stats(void) {
+    return &s_stats;
+}
+
+sim_view_t *sim_get_view(void) {
+    return &s_view;
+}
+
+void hal_log(char level, const char *tag, const char *fmt, ...) {
+    if (level == 'I' && !s_verbose) {
+        return;
+    }
+    fprintf(stderr, "%c (%lld) %s: ", level, (long long)(s_now_us / 1000), tag);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+int64_t hal_time_us(void) {
+    return s_now_us;
+}
+
+/* Fast-forward runs the virtual clock itself, so there is only one */
+int64_t hal_mono_us(void) {
+    return s_now_us;
+}
+
+int64_t hal_boot_loader_us(void) {
+    return -1;
+}
+
+/* Let the clock run on to the new end time; hal_event_receive() fires the
+ * timers on the way */
+void hal_time_advance(int64_t us) {
+    s_end_us = (s_end_us > s_now_us ? s_end_us : s_now_us) + us;
+}
+
+hal_timer_t hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg) {
+    if (s_timer_count >= SIM_MAX_TIMERS) {
+        fprintf(stderr, "sim: too many timers\n");
+        abort();
+    }
+    hal_timer_t timer = &s_timers[s_timer_count++];
+    *timer = (struct hal_timer){ .name = name, .cb = cb, .arg = arg };
+    return timer;
+}
+
+void hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us) {
+    timer->armed = true;
+    timer->deadline_us = s_now_us + (int64_t)timeout_us;
+    timer->period_us = 0;
+}
+
+void hal_timer_start_periodic(hal_timer_t timer, uint64_t period_us) {
+    timer->armed = true;
+    timer->deadline_us = s_now_us + (int64_t)period_us;
+    timer->period_us = period_us;
+}
+
+void hal_timer_stop(hal_timer_t timer) {
+    timer->armed = false;
+}
+
+/* Timers fire exactly on time on the virtual clock */
+size_t hal_timer_get_stats(hal_timer_stats_t *stats, size_t max) {
+    size_t count = s_timer_count < max ? s_timer_count : max;
+    for (size_t i = 0; i < count; i++) {
+        stats[i] = (hal_timer_stats_t){ .name = s_timers[i].name, .fires = s_timers[i].fires };
+    }
+    return count;
+}
+
+bool hal_event_init(void) {
+    event_bus_init();
+    return true;
+}
+
+bool hal_event_post(const app_event_t *evt) {
+    bool drop_tick = evt->type == EVENT_TICK_1HZ && s_tick_drop_every != 0 &&
+                     ++s_tick_posts % s_tick_drop_every == 0;
+    app_event_t stamped = *evt;
+    stamped.posted_us = (uint32_t)s_now_us;
+    if (drop_tick || !event_bus_post(&stamped)) {
+        s_stats.events_dropped++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Deliver a scripted input the way the device drivers would
+ */
+static void fire_input(const sim_input_t *input) {
+    if (input->type == SIM_INPUT_BUTTON) {
+        app_event_t evt = { .type = EVENT_BUTTON_PRESS, .value = 0 };
+        hal_event_post(&evt);
+        return;
+    }
+
+    /* One watch point event per detent, as from the PCNT ISR */
+    int32_t step = input->detents > 0 ? LOGIC_ENCODER_DIVISOR : -LOGIC_ENCODER_DIVISOR;
+    int32_t detents = input->detents > 0 ? input->detents : -input->detents;
+    for (int32_t i = 0; i < detents; i++) {
+        s_encoder_count += step;
+        app_event_t evt = { .type = EVENT_ENCODER_CHANGE, .value = s_encoder_count };
+        hal_event_post(&evt);
+    }
+}
+
+static void trace_write(const char *line, size_t len) {
+    s_stats.trace_lines++;
+    if (s_trace_file != NULL) {
+        fwrite(line, 1, len, s_trace_file);
+    }
+}
+
+/**
+ * Armed timer with the earliest deadline, or NULL
+ */
+static hal_timer_t next_timer_due(void) {
+    hal_timer_t next_timer = NULL;
+    for (size_t i = 0; i < s_timer_count; i++) {
+        hal_timer_t t = &s_timers[i];
+        if (t->armed && (next_timer == NULL || t->deadline_us < next_timer->deadline_us)) {
+            next_timer = t;
+        }
+    }
+    return next_timer;
+}
+
+/**
+ * Move the virtual clock to the next timer expiry or scripted input and
+ * fire it. Timers win ties, like an input that arrives just after a tick.
+ *
+ * @return false when nothing is left to happen before the end time
+ */
+static bool advance(void) {
+    hal_timer_t next_timer = next_timer_due();
+    const sim_input_t *next_input = s_input_next < s_input_count ? &s_inputs[s_input_next] : NULL;
+
+    if (next_timer != NULL && (next_input == NULL || next_timer->deadline_us <= next_input->at_us)) {
+        if (next_timer->deadline_us > s_end_us) {
+            return false;
+        }
+        s_now_us = next_timer->deadline_us;
+        if (next_timer->period_us != 0) {
+            next_timer->deadline_us += (int64_t)next_timer->period_us;
+        } else {
+            next_timer->armed = false;
+        }
+        s_stats.timer_fires++;
+        next_timer->fires++;
+        next_timer->cb(next_timer->arg);
+        return true;
+    }
+
+    if (next_input != NULL) {
+        if (next_input->at_us > s_end_us) {
+            return false;
+        }
+        if (next_input->at_us > s_now_us) {
+            s_now_us = next_input->at_us;
+        }
+        s_input_next++;
+        fire_input(next_input);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * The simulated panel refreshes in one go: one frame with one flush,
+ * finished at once
+ */
+static void refresh(void) {
+    uint32_t now_us = (uint32_t)s_now_us;
+    latency_frame_start(now_us);
+    latency_flush_start();
+    latency_frame_ready(now_us);
+    latency_flush_done(now_us);
+}
+
+bool hal_event_receive(app_event_t *evt) {
+    if (s_in_event) {
+        uint64_t elapsed = wall_ns() - s_receive_ns;
+        sim_event_stats_t *st = &s_stats.events[s_current_type];
+        st->processing_ns_total += elapsed;
+        if (elapsed > st->processing_ns_max) {
+            st->processing_ns_max = elapsed;
+        }
+        s_in_event = false;
+    }
+
+    while (!event_bus_pop(evt)) {
+        /* The loop is about to block, which is when the device flushes the
+         * trace, and the LVGL task draws what the loop posted */
+        view_drain();
+        refresh();
+        trace_flush(trace_write);
+        if (advance()) {
+            continue;
+        }
+        /* Console mode: the clock catches up with ff, then the next
+         * command is read */
+        if (sim_console_is_open()) {
+            if (s_end_us > s_now_us) {
+                s_now_us = s_end_us;
+            }
+            if (sim_console_poll()) {
+                continue;
+            }
+        }
+        s_stats.end_us = s_now_us;
+        return false;
+    }
+
+    if ((unsigned)evt->type < SIM_EVENT_TYPE_COUNT) {
+        s_stats.events[evt->type].received++;
+        s_current_type = evt->type;
+        s_in_event = true;
+    }
+    s_receive_ns = wall_ns();
+    return true;
+}
+
+void hal_encoder_init(void) {
+    s_encoder_count = 0;
+}
+
+int32_t hal_encoder_get_count(void) {
+    return s_encoder_count;
+}
+
+void hal_encoder_inject(int32_t detents) {
+    fire_input(&(sim_input_t){ .at_us = s_now_us, .type = SIM_INPUT_ENCODER, .detents = detents });
+}
+
+void hal_encoder_post(void) {
+    app_event_t evt = { .type = EVENT_ENCODER_CHANGE, .value = s_encoder_count };
+    hal_event_post(&evt);
+}
+
+void hal_button_init(void) {
+}
+
+void hal_button_inject(void) {
+    fire_input(&(sim_input_t){ .at_us = s_now_us, .type = SIM_INPUT_BUTTON });
+}
+
+bool hal_display_start(int rotation_deg) {
+    (void)rotation_deg;
+    return true;
+}
+
+void hal_display_lock(void) {
+    s_stats.display_locks++;
+}
+
+void hal_display_unlock(void) {
+    /* The panel refreshes as the lock is released */
+    refresh();
+}
+
+void hal_display_refresh_now(void) {
+    s_stats.refreshes_now++;
+}
+
+void hal_backlight_set(bool on) {
+    s_view.backlight_on = on;
+}
+
+/* Sleep lasts until the next scripted input, which is then delivered. The
+ * device sleeps through timers; here a due timer ends the sleep instead so
+ * that the virtual clock never runs backwards. */
+hal_wake_t hal_sleep_until_input(void) {
+    s_stats.sleeps++;
+    if (s_input_next >= s_input_count || s_inputs[s_input_next].at_us > s_end_us) {
+        return HAL_WAKE_NONE;
+    }
+    const sim_input_t *input = &s_inputs[s_input_next];
+    hal_timer_t next_timer = next_timer_due();
+    if (next_timer != NULL && next_timer->deadline_us <= input->at_us) {
+        return HAL_WAKE_TIMER;
+    }
+
+    if (input->at_us > s_now_us) {
+        s_now_us = input->at_us;
+    }
+    s_input_next++;
+    fire_input(input);
+    return input->type == SIM_INPUT_BUTTON ? HAL_WAKE_BUTTON : HAL_WAKE_ENCODER;
+}
+
+void hal_buzzer_play_alarm(melody_id_t melody) {
+    (void)melody;
+    if (s_stats.alarm_count < SIM_MAX_ALARMS) {
+        s_stats.alarm_us[s_stats.alarm_count] = s_now_us;
+    }
+    s_stats.alarm_count++;
+}
+
+void hal_buzzer_stop(void) {
+}
+
+bool hal_storage_load(void *data, size_t size) {
+    if (s_storage_size != size) {
+        return false;
+    }
+    memcpy(data, s_storage, size);
+    return true;
+}
+
+bool hal_storage_save(const void *data, size_t size) {
+    if (size > sizeof(s_storage)) {
+        return false;
+    }
+    memcpy(s_storage, data, size);
+    s_storage_size = size;
+    s_stats.storage_writes++;
+    return true;
+}
+
+/* Flushed from hal_event_receive() instead of an idle hook */
+void hal_trace_start(void) {
+}
+
+/* Nothing to wait for on the virtual clock */
+void hal_trace_drain(uint32_t for_ms) {
+    (void)for_ms;
+    trace_flush(trace_write);
+}
+
+void hal_console_start(void) {
+    if (s_console && !sim_console_open()) {
+        exit(2);
+    }
+}
+
+/* Nothing allocates after boot here either, but it is not enforced */
+void hal_heap_freeze(void) {
+}
+
+void hal_report_tasks(FILE *out) {
+    fprintf(out, "simulator: one thread, no scheduler\n");
+}
+
+void hal_report_memory(FILE *out) {
+    fprintf(out, "simulator: heap not tracked, no LVGL\n");
+}
+
+void hal_display_benchmark(FILE *out) {
+    fprintf(out, "simulator: no panel to benchmark\n");
+}
+
+/* One thread: the loop runs until the script is done */
+void hal_loop_start(hal_job_t loop) {
+    loop();
+}
+
+/* No second core to use: run the job in place */
+void hal_background_start(hal_job_t job) {
+    job();
+}
+
+void hal_background_join(void) {
+}
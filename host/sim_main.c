@@ -0,0 +1,272 @@
+/**
+ * Runs the real app_main() against the simulated HAL.
+ *
+ * Default scenario: dial in a brew, start it, let the alarm flash for a
+ * while, stop it, then leave the unit alone until it goes to sleep, wake it
+ * with the encoder and let it go back to sleep. With -b, further brews are
+ * dialled in while the first one runs, each a minute shorter. With -j they
+ * are all as long as the first, so the later ones end while the first one's
+ * alarm is sounding and one click stops it. Reports the
+ * brew timing errors, event bus counters and the per-event processing cost
+ * of the loop body. With -t, the binary trace is written to trace_file for
+ * host/trace_decode.py. With -r, the input recorder is dumped to
+ * record_file at the end, for host/replay. With -c, there is no script:
+ * the application is driven from a pty with the device console commands
+ * (see sim_console.c) until quit.
+ *
+ * Usage: tea_sim [-m minutes] [-a alarm_secs] [-b brews] [-j] [-d drop_every_n_ticks] [-t trace_file] [-r record_file] [-c] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "hal.h"
+#include "logic.h"
+#include "view.h"
+#include "event_bus.h"
+#include "recorder.h"
+#include "latency.h"
+#include "settings.h"
+
+#define US_PER_SEC 1000000LL
+
+/* Allowed alarm lateness: one tick retry after a dropped final tick */
+#define ALARM_TOLERANCE_US (20 * 1000)
+
+/* Gap between the starts of consecutive brews */
+#define BREW_SPACING_US (2 * US_PER_SEC)
+
+void app_main(void);
+
+static const char *s_event_names[SIM_EVENT_TYPE_COUNT] = {
+    "NONE", "BUTTON_PRESS", "ENCODER_CHANGE", "TICK_1HZ", "TICK_FAST", "INACTIVITY", "RECORDER_DUMP",
+    "SETTINGS_SAVE",
+};
+
+static uint64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static FILE *s_record_file = NULL;
+
+static void record_write(const char *line, size_t len) {
+    fwrite(line, 1, len, s_record_file);
+}
+
+/**
+ * Dump the input recorder to a file, as the device does over serial
+ */
+static bool write_recording(const char *path) {
+    s_record_file = fopen(path, "w");
+    if (s_record_file == NULL) {
+        perror(path);
+        return false;
+    }
+    recorder_dump(record_write);
+    return fclose(s_record_file) == 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-m minutes] [-a alarm_secs] [-b brews] [-j] [-d drop_every_n_ticks] [-t trace_file] [-r record_file] [-c] [-v]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int minutes = LOGIC_MAX_TIME_SECS / 60;
+    int alarm_secs = 10;
+    int brews = 1;
+    bool joined = false;
+    int tick_drop = 0;
+    bool verbose = false;
+    bool console = false;
+    const char *trace_path = NULL;
+    const char *record_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            minutes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            alarm_secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            brews = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            joined = true;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            tick_drop = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            console = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (minutes * 60 > LOGIC_MAX_TIME_SECS || alarm_secs < 0 || tick_drop < 0 ||
+        brews < 1 || brews > LOGIC_MAX_TIMERS || (minutes - (joined ? 0 : brews - 1)) * 60 < LOGIC_MIN_TIME_SECS ||
+        (brews > 1 && !joined && alarm_secs >= 58) ||
+        (joined && (int64_t)alarm_secs * US_PER_SEC <= (brews - 1) * BREW_SPACING_US)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    sim_reset();
+    sim_set_verbose(verbose);
+    sim_set_tick_drop((uint32_t)tick_drop);
+    sim_set_console(console);
+    FILE *trace_file = NULL;
+    if (trace_path != NULL) {
+        trace_file = fopen(trace_path, "w");
+        if (trace_file == NULL) {
+            perror(trace_path);
+            return 2;
+        }
+        sim_set_trace_file(trace_file);
+    }
+
+    if (console) {
+        app_main();
+        sim_console_close();
+        if (trace_file != NULL) {
+            fclose(trace_file);
+        }
+        if (record_path != NULL && !write_recording(record_path)) {
+            return 2;
+        }
+        printf("console session ended at %.1f s\n", (double)sim_get_stats()->end_us / US_PER_SEC);
+        return 0;
+    }
+
+    /* Script: dial from the 5 minute default and start. Each further brew is
+     * dialled one minute shorter while the others run, so they end in
+     * reverse order 58 s apart. Every alarm is stopped alarm_secs later.
+     * Joined brews are dialled back to the same length and end 2 s apart,
+     * all within the first alarm, which is stopped alarm_secs after it. */
+    const int64_t dial_us = 500 * 1000;
+    const int64_t start_us = 1 * US_PER_SEC;
+    int64_t expected_alarm_us[LOGIC_MAX_TIMERS];
+    int alarms = joined ? 1 : brews;
+    sim_schedule_encoder(dial_us, minutes - 5);
+    for (int k = 0; k < brews; k++) {
+        int64_t at_us = start_us + (int64_t)k * BREW_SPACING_US;
+        if (k > 0) {
+            sim_schedule_encoder(at_us - US_PER_SEC, -1);
+            if (joined) {
+                sim_schedule_encoder(at_us - US_PER_SEC / 2, 1);
+            }
+        }
+        sim_schedule_button(at_us);
+        if (joined) {
+            expected_alarm_us[k] = at_us + (int64_t)minutes * 60 * US_PER_SEC;
+        } else {
+            expected_alarm_us[brews - 1 - k] = at_us + (int64_t)(minutes - k) * 60 * US_PER_SEC;
+        }
+    }
+    int64_t stop_us = 0;
+    for (int k = 0; k < alarms; k++) {
+        stop_us = expected_alarm_us[k] + (int64_t)alarm_secs * US_PER_SEC;
+        sim_schedule_button(stop_us);
+    }
+    /* Wake from sleep with the encoder half a minute after it dozed off */
+    sim_schedule_encoder(stop_us + 90 * US_PER_SEC, -1);
+
+    uint64_t wall_start = wall_ns();
+    app_main();
+    uint64_t wall_elapsed = wall_ns() - wall_start;
+    if (trace_file != NULL) {
+        fclose(trace_file);
+    }
+    if (record_path != NULL && !write_recording(record_path)) {
+        return 2;
+    }
+
+    const sim_stats_t *stats = sim_get_stats();
+    const sim_view_t *view = sim_get_view();
+
+    printf("simulated %.1f s in %.3f ms wall time\n",
+           (double)stats->end_us / US_PER_SEC, (double)wall_elapsed / 1e6);
+
+    int exit_code = 0;
+    if (stats->alarm_count != (uint32_t)alarms) {
+        printf("brew:     %u alarms for %d brews, %d expected\n", stats->alarm_count, brews, alarms);
+        exit_code = 1;
+    }
+    for (int k = 0; k < alarms && k < (int)stats->alarm_count; k++) {
+        int64_t error_us = stats->alarm_us[k] - expected_alarm_us[k];
+        printf("brew:     %d min, alarm at %.6f s, error %+lld us\n",
+               joined ? minutes : minutes - (brews - 1 - k), (double)stats->alarm_us[k] / US_PER_SEC, (long long)error_us);
+        if (error_us < 0 || error_us > ALARM_TOLERANCE_US) {
+            exit_code = 1;
+        }
+    }
+    printf("view:     %u updates, %u renderer kicks, %u flash toggles, up to %u other brews shown, final state %d, backlight %s\n",
+           view->updates, view->kicks, view->flash_toggles, view->other_timers_max, view->state,
+           view->backlight_on ? "on" : "off");
+    /* The flash steps on a 500 ms grid from the start of each alarm, whatever
+     * else replans the refresh timer meanwhile: one phase per half second of
+     * alarm, the last one due together with the stop click */
+    uint32_t flash_phases = stats->events[EVENT_TICK_FAST].received;
+    uint32_t expected_phases = (uint32_t)(alarms * alarm_secs * 2);
+    printf("flash:    %u phases, %u expected\n", flash_phases, expected_phases);
+    if (flash_phases != expected_phases) {
+        exit_code = 1;
+    }
+    printf("events:   %u timer fires, %u display locks, %u dropped\n",
+           stats->timer_fires, stats->display_locks, stats->events_dropped);
+    printf("power:    %u sleeps, %u wake refreshes\n", stats->sleeps, stats->refreshes_now);
+
+    /* Every countdown step and flash phase comes from the one refresh timer */
+    hal_timer_stats_t timers[8];
+    size_t timer_count = hal_timer_get_stats(timers, sizeof(timers) / sizeof(timers[0]));
+    for (size_t i = 0; i < timer_count; i++) {
+        if (strcmp(timers[i].name, "refresh") == 0) {
+            printf("refresh:  %u wakeups, %.1f per brew, %u updates with tenths\n",
+                   timers[i].fires, (double)timers[i].fires / brews, view->tenths_updates);
+        }
+    }
+    printf("trace:    %u lines flushed\n", stats->trace_lines);
+
+    settings_stats_t settings;
+    settings_get_stats(&settings);
+    printf("settings: %u changes, %u storage writes\n", settings.changes, stats->storage_writes);
+
+    /* Every stage is 0 us on the virtual clock; the count shows the inputs
+     * that were followed all the way to a flushed frame */
+    latency_summary_t total, alarm;
+    latency_get(LATENCY_STAGE_TOTAL, &total);
+    latency_get(LATENCY_STAGE_ALARM, &alarm);
+    printf("latency:  %u inputs timed to the panel, %u alarm stops\n", total.count, alarm.count);
+
+    event_bus_stats_t bus;
+    event_bus_get_stats(&bus);
+    printf("bus:      button %u posted, %u dropped, high water %u/%u\n",
+           bus.rings[EVENT_BUS_RING_BUTTON].posted, bus.rings[EVENT_BUS_RING_BUTTON].dropped,
+           bus.rings[EVENT_BUS_RING_BUTTON].high_water, bus.rings[EVENT_BUS_RING_BUTTON].depth);
+    printf("          timer %u posted, %u dropped, high water %u/%u\n",
+           bus.rings[EVENT_BUS_RING_TIMER].posted, bus.rings[EVENT_BUS_RING_TIMER].dropped,
+           bus.rings[EVENT_BUS_RING_TIMER].high_water, bus.rings[EVENT_BUS_RING_TIMER].depth);
+    printf("          encoder %u posted, %u coalesced\n", bus.encoder_posted, bus.encoder_coalesced);
+
+    printf("\n%-16s %8s %12s %12s\n", "event", "count", "avg ns", "max ns");
+    for (int t = 0; t < SIM_EVENT_TYPE_COUNT; t++) {
+        const sim_event_stats_t *st = &stats->events[t];
+        if (st->received == 0) {
+            continue;
+        }
+        printf("%-16s %8u %12.0f %12llu\n", s_event_names[t], st->received,
+               (double)st->processing_ns_total / st->received,
+               (unsigned long long)st->processing_ns_max);
+    }
+
+    if (view->state != VIEW_STATE_SLEEP || stats->sleeps == 0 || (tick_drop == 0 && stats->events_dropped != 0)) {
+        exit_code = 1;
+    }
+    return exit_code;
+}
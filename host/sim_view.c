@@ -0,0 +1,44 @@
+/**
+ * view.h stub for the simulator: records what would have been drawn.
+ */
+#include "view.h"
+#include "sim.h"
+
+void view_init(void) {
+    sim_view_t *view = sim_get_view();
+    view->state = VIEW_STATE_SETUP;
+    view->time_secs = 0;
+    view->tenths = -1;
+    view->progress = 100;
+}
+
+void view_update(view_state_t state, uint32_t time_secs, int8_t tenths, uint8_t progress, uint8_t other_timers) {
+    sim_view_t *view = sim_get_view();
+    view->state = state;
+    view->time_secs = time_secs;
+    view->tenths = tenths;
+    if (tenths >= 0) {
+        view->tenths_updates++;
+    }
+    view->progress = progress;
+    view->other_timers = other_timers;
+    if (other_timers > view->other_timers_max) {
+        view->other_timers_max = other_timers;
+    }
+    view->updates++;
+}
+
+void view_set_alarm_flash(bool flash_on) {
+    sim_view_t *view = sim_get_view();
+    view->alarm_flash_on = flash_on;
+    view->flash_toggles++;
+}
+
+void view_kick(void) {
+    sim_get_view()->kicks++;
+}
+
+void view_get_flush_stats(view_flush_stats_t *stats) {
+    /* Nothing is rendered in the simulator */
+    *stats = (view_flush_stats_t){0};
+}
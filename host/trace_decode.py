@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Decode the binary trace from main/trace.c into Chrome trace event JSON,
+which loads in Perfetto (ui.perfetto.dev) or chrome://tracing.
+
+Reads a serial log or a tea_sim -t file, picks out the trace lines by their
+prefix and ignores everything else. Trace point names, phases, tracks and
+argument names come from the TRACE_POINTS table in main/trace.h, so the
+decoder never needs changing when a trace point is added. Each track becomes
+one thread row, in the order the tracks first appear in the table. A begin
+or end that does not pair up on its track is reported, as it would show up
+as wrong nesting in the viewer.
+
+Usage: trace_decode.py [-H main/trace.h] [-o out.json] [log ...]
+"""
+import argparse
+import base64
+import binascii
+import json
+import os
+import re
+import struct
+import sys
+
+DEFAULT_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main", "trace.h")
+
+RECORD = struct.Struct("<IHHi")  # ts_us, id, arg0, arg1
+POINT_RE = re.compile(r'X\(\s*(\w+)\s*,\s*(\d+)\s*,\s*\'(\w)\'\s*,\s*"([^"]*)"\s*,\s*"([^"]*)"\s*,\s*"([^"]*)"\s*\)')
+PREFIX_RE = re.compile(r'#define\s+TRACE_LINE_PREFIX\s+"([^"]*)"')
+
+
+def load_points(header_path):
+    """Trace point table and line prefix from trace.h"""
+    with open(header_path) as f:
+        text = f.read()
+    table = text[text.index("#define TRACE_POINTS(X)"):]
+    points = []
+    for m in POINT_RE.finditer(table.split("\n\n", 1)[0]):
+        name, _level, phase, track, arg0, arg1 = m.groups()
+        points.append({"name": name, "phase": phase, "track": track, "args": (arg0, arg1)})
+    prefix = PREFIX_RE.search(text)
+    if not points or prefix is None:
+        sys.exit(f"{header_path}: no TRACE_POINTS table or TRACE_LINE_PREFIX")
+    return points, prefix.group(1)
+
+
+def read_records(files, prefix):
+    """Yield (ts_us, id, arg0, arg1) from every trace line, in order"""
+    for f in files:
+        for lineno, line in enumerate(f, 1):
+            pos = line.find(prefix)
+            if pos < 0:
+                continue
+            try:
+                data = base64.b64decode(line[pos + len(prefix):].strip(), validate=True)
+            except binascii.Error:
+                print(f"{f.name}:{lineno}: bad trace line, skipped", file=sys.stderr)
+                continue
+            for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+                yield RECORD.unpack_from(data, offset)
+
+
+def decode(records, points):
+    """Chrome trace events, with the 32-bit timestamps unwrapped"""
+    tracks = {}
+    for point in points:
+        tracks.setdefault(point["track"], len(tracks) + 1)
+    open_begins = {}
+    unpaired = 0
+    events = []
+    wraps = 0
+    last_ts = None
+    for ts, point_id, arg0, arg1 in records:
+        if last_ts is not None and ts < last_ts and last_ts - ts > 1 << 31:
+            wraps += 1
+        last_ts = ts
+        point = points[point_id] if point_id < len(points) else \
+            {"name": f"ID_{point_id}", "phase": "i", "track": "unknown", "args": ("arg0", "arg1")}
+
+        tid = tracks.setdefault(point["track"], len(tracks) + 1)
+        stack = open_begins.setdefault(tid, [])
+        if point["phase"] == "B":
+            stack.append(point["name"])
+        elif point["phase"] == "E":
+            if stack:
+                stack.pop()
+            else:
+                unpaired += 1
+        event = {
+            "name": point["name"].lower(),
+            "ph": point["phase"],
+            "ts": ts + (wraps << 32),
+            "pid": 1,
+            "tid": tid,
+        }
+        args = {k: v for k, v in zip(point["args"], (arg0, arg1)) if k != "unused"}
+        if args:
+            event["args"] = args
+        if point["phase"] == "i":
+            event["s"] = "t"
+        events.append(event)
+
+    for track, tid in tracks.items():
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": track}})
+        events.append({"name": "thread_sort_index", "ph": "M", "pid": 1, "tid": tid,
+                       "args": {"sort_index": tid}})
+    if unpaired:
+        print(f"{unpaired} trace ends without a begin on their track", file=sys.stderr)
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("logs", nargs="*", type=argparse.FileType("r"), default=[sys.stdin],
+                        help="serial logs or tea_sim -t files (default: stdin)")
+    parser.add_argument("-H", "--header", default=DEFAULT_HEADER, help="trace.h with the trace point table")
+    parser.add_argument("-o", "--output", type=argparse.FileType("w"), default=sys.stdout,
+                        help="output JSON (default: stdout)")
+    args = parser.parse_args()
+
+    points, prefix = load_points(args.header)
+    events = decode(read_records(args.logs, prefix), points)
+    json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, args.output)
+    args.output.write("\n")
+
+    lost = sum(e.get("args", {}).get("records", 0) for e in events if e["name"] == "lost")
+    print(f"{len(events) - sum(e['ph'] == 'M' for e in events)} records, {lost} lost", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
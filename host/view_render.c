@@ -0,0 +1,322 @@
+/**
+ * Headless renderer for the view.
+ *
+ * Runs main/view.c, unchanged, against LVGL with a 240x240 RGB565 frame
+ * buffer in place of the panel, and walks it through a fixed sweep of view
+ * models: every state, countdown texts of each width, tenths, progress,
+ * the other-timers badge and both alarm flash phases. Each step is drawn
+ * the way the device draws it, as a partial refresh on top of the previous
+ * frame, and the whole frame buffer is hashed afterwards.
+ *
+ * The hashes are checked against a golden file, so any change to what the
+ * view puts on screen shows up as a named mismatch. The time each refresh
+ * takes and the pixels it flushes are printed alongside; with -n the sweep
+ * is repeated and the fastest time of each step kept, and every pass must
+ * produce the same hashes as the first.
+ *
+ * Usage: view_render [-g golden.txt] [-u] [-n passes] [-q]
+ *
+ * -u writes the golden file from this run instead of checking it. Exits
+ * non-zero on a mismatch, or when the golden file is missing.
+ *
+ * The hashes depend on the LVGL version and on lv_conf.h in host/shim/, not
+ * only on view.c: regenerate the file with -u when either changes on
+ * purpose. The host build has no Kconfig, so the alarm flash is the redraw
+ * variant; the panel variant leaves the frame as it is.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lvgl.h>
+
+#include "view.h"
+#include "display.h"
+#include "hal.h"
+
+#define SCREEN_W 240
+#define SCREEN_H 240
+
+#define DEFAULT_PASSES 5
+
+#ifndef VIEW_GOLDEN_PATH
+#define VIEW_GOLDEN_PATH "view_golden.txt"
+#endif
+
+/**
+ * One step of the sweep: a view model and the flash phase
+ */
+typedef struct {
+    const char *name;
+    view_state_t state;
+    uint32_t time_secs;
+    int8_t tenths;
+    uint8_t progress;
+    uint8_t other_timers;
+    bool flash_on;
+} render_case_t;
+
+/* In drawing order; each step is a delta from the one before, so the order
+ * is part of what is checked */
+static const render_case_t s_cases[] = {
+    { "setup 3:00",            VIEW_STATE_SETUP,   180, -1,   0, 0, false },
+    { "setup 3:00 again",      VIEW_STATE_SETUP,   180, -1,   0, 0, false },
+    { "setup 3:30",            VIEW_STATE_SETUP,   210, -1,   0, 0, false },
+    { "setup 0:30",            VIEW_STATE_SETUP,    30, -1,   0, 0, false },
+    { "setup 10:00",           VIEW_STATE_SETUP,   600, -1,   0, 0, false },
+    { "setup 10:00 +1",        VIEW_STATE_SETUP,   600, -1,   0, 1, false },
+    { "running 10:00",         VIEW_STATE_RUNNING, 600, -1,   0, 1, false },
+    { "running 9:59",          VIEW_STATE_RUNNING, 599, -1,   0, 1, false },
+    { "running 9:54 1%",       VIEW_STATE_RUNNING, 594, -1,   1, 1, false },
+    { "running 5:00 50%",      VIEW_STATE_RUNNING, 300, -1,  50, 1, false },
+    { "running 5:00 50% +3",   VIEW_STATE_RUNNING, 300, -1,  50, 3, false },
+    { "running 1:00 90%",      VIEW_STATE_RUNNING,  60, -1,  90, 3, false },
+    { "running 0:59 90%",      VIEW_STATE_RUNNING,  59, -1,  90, 0, false },
+    { "running 9.9",           VIEW_STATE_RUNNING,   9,  9,  98, 0, false },
+    { "running 9.8",           VIEW_STATE_RUNNING,   9,  8,  98, 0, false },
+    { "running 0.1",           VIEW_STATE_RUNNING,   0,  1, 100, 0, false },
+    { "alarm",                 VIEW_STATE_ALARM,     0, -1, 100, 0, false },
+    { "alarm flash on",        VIEW_STATE_ALARM,     0, -1, 100, 0, true  },
+    { "alarm flash off",       VIEW_STATE_ALARM,     0, -1, 100, 0, false },
+    { "alarm flash on +2",     VIEW_STATE_ALARM,     0, -1, 100, 2, true  },
+    { "setup after alarm",     VIEW_STATE_SETUP,   180, -1,   0, 2, false },
+    { "sleep",                 VIEW_STATE_SLEEP,   180, -1,   0, 2, false },
+};
+
+#define CASE_COUNT (sizeof(s_cases) / sizeof(s_cases[0]))
+
+/* Result of one step */
+typedef struct {
+    uint64_t hash;
+    uint32_t render_us;  /* Fastest over all passes */
+    uint32_t dirty_px;
+} render_result_t;
+
+/* Frame buffer the view is drawn into, as the panel would receive it */
+static uint16_t s_framebuffer[SCREEN_W * SCREEN_H] __attribute__((aligned(64)));
+
+/* Pixels flushed since the last reset */
+static uint32_t s_dirty_px = 0;
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Stand-ins for what view.c and view_mailbox.c use from the rest of the
+ * firmware. The flash is drawn, so the panel is never inverted. */
+
+int64_t esp_timer_get_time(void) {
+    return monotonic_us();
+}
+
+int64_t hal_time_us(void) {
+    return monotonic_us();
+}
+
+int64_t hal_mono_us(void) {
+    return monotonic_us();
+}
+
+void display_invert(bool inverted) {
+    (void)inverted;
+}
+
+static uint32_t tick_get_cb(void) {
+    return (uint32_t)(monotonic_us() / 1000);
+}
+
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map) {
+    (void)px_map;
+    s_dirty_px += (uint32_t)lv_area_get_size(area);
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * 64-bit FNV-1a over the frame buffer
+ */
+static uint64_t frame_hash(void) {
+    const uint8_t *p = (const uint8_t *)s_framebuffer;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < sizeof(s_framebuffer); i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * Draw one step and hash the result
+ */
+static void render_case(const render_case_t *c, render_result_t *result) {
+    view_update(c->state, c->time_secs, c->tenths, c->progress, c->other_timers);
+    view_set_alarm_flash(c->flash_on);
+
+    s_dirty_px = 0;
+    int64_t start_us = monotonic_us();
+    lv_refr_now(NULL);
+    result->render_us = (uint32_t)(monotonic_us() - start_us);
+    result->dirty_px = s_dirty_px;
+    result->hash = frame_hash();
+}
+
+/**
+ * Run the sweep once from a fully invalidated screen
+ */
+static void render_pass(render_result_t *results) {
+    lv_obj_invalidate(lv_screen_active());
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        render_case(&s_cases[i], &results[i]);
+    }
+}
+
+/**
+ * Read the golden hashes, one "<hash> <name>" line per step in sweep order.
+ * Returns false if the file cannot be read or does not match the sweep.
+ */
+static bool golden_load(const char *path, uint64_t *hashes) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot read %s; create it with -u\n", path);
+        return false;
+    }
+
+    char line[128];
+    size_t count = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        char *name = strchr(line, ' ');
+        if (count >= CASE_COUNT || name == NULL || strcmp(name + 1, s_cases[count].name) != 0) {
+            fprintf(stderr, "%s does not match the sweep at step %zu; regenerate it with -u\n",
+                    path, count);
+            ok = false;
+            break;
+        }
+        hashes[count++] = strtoull(line, NULL, 16);
+    }
+    fclose(f);
+
+    if (ok && count != CASE_COUNT) {
+        fprintf(stderr, "%s has %zu steps, the sweep %zu; regenerate it with -u\n",
+                path, count, CASE_COUNT);
+        ok = false;
+    }
+    return ok;
+}
+
+static bool golden_write(const char *path, const render_result_t *results) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "# view_render golden frame hashes (FNV-1a 64 over the RGB565 frame)\n");
+    fprintf(f, "# LVGL %d.%d.%d; regenerate with view_render -u\n",
+            LVGL_VERSION_MAJOR, LVGL_VERSION_MINOR, LVGL_VERSION_PATCH);
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        fprintf(f, "%016llx %s\n", (unsigned long long)results[i].hash, s_cases[i].name);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *golden_path = VIEW_GOLDEN_PATH;
+    bool update = false;
+    bool quiet = false;
+    int passes = DEFAULT_PASSES;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:un:q")) != -1) {
+        switch (opt) {
+            case 'g': golden_path = optarg; break;
+            case 'u': update = true; break;
+            case 'n': passes = atoi(optarg); break;
+            case 'q': quiet = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-g golden.txt] [-u] [-n passes] [-q]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (passes < 1) {
+        passes = 1;
+    }
+
+    lv_init();
+    lv_tick_set_cb(tick_get_cb);
+    lv_display_t *disp = lv_display_create(SCREEN_W, SCREEN_H);
+    lv_display_set_color_format(disp, LV_COLOR_FORMAT_RGB565);
+    lv_display_set_buffers(disp, s_framebuffer, NULL, sizeof(s_framebuffer),
+                           LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(disp, flush_cb);
+
+    view_init();
+
+    render_result_t results[CASE_COUNT];
+    render_result_t pass_results[CASE_COUNT];
+    render_pass(results);
+
+    int failures = 0;
+    for (int pass = 1; pass < passes; pass++) {
+        render_pass(pass_results);
+        for (size_t i = 0; i < CASE_COUNT; i++) {
+            if (pass_results[i].hash != results[i].hash) {
+                fprintf(stderr, "pass %d: \"%s\" drew a different frame than pass 0\n",
+                        pass, s_cases[i].name);
+                failures++;
+            }
+            if (pass_results[i].render_us < results[i].render_us) {
+                results[i].render_us = pass_results[i].render_us;
+            }
+        }
+    }
+
+    uint64_t golden[CASE_COUNT];
+    bool have_golden = !update && golden_load(golden_path, golden);
+    if (!update && !have_golden) {
+        failures++;
+    }
+
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        const render_result_t *r = &results[i];
+        bool match = !have_golden || golden[i] == r->hash;
+        if (!match) {
+            failures++;
+        }
+        if (!quiet || !match) {
+            printf("%-22s %016llx %6lu us %6lu px%s\n", s_cases[i].name,
+                   (unsigned long long)r->hash, (unsigned long)r->render_us,
+                   (unsigned long)r->dirty_px, match ? "" : "  MISMATCH");
+        }
+        total_us += r->render_us;
+        if (r->render_us > max_us) {
+            max_us = r->render_us;
+        }
+    }
+    printf("%zu frames, render mean %llu us, max %lu us (best of %d passes)\n",
+           CASE_COUNT, (unsigned long long)(total_us / CASE_COUNT), (unsigned long)max_us, passes);
+
+    if (update) {
+        if (failures > 0 || !golden_write(golden_path, results)) {
+            fprintf(stderr, "golden file not written\n");
+            return 1;
+        }
+        printf("wrote %s\n", golden_path);
+        return 0;
+    }
+    if (failures > 0) {
+        printf("%d failures against %s\n", failures, golden_path);
+        return 1;
+    }
+    printf("all frames match %s\n", golden_path);
+    return 0;
+}
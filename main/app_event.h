@@ -0,0 +1,29 @@
+#ifndef APP_EVENT_H
+#define APP_EVENT_H
+
+#include <stdint.h>
+
+/**
+ * Event types for the thread-safe event loop
+ */
+typedef enum {
+    EVENT_NONE,
+    EVENT_BUTTON_PRESS,
+    EVENT_ENCODER_CHANGE,  /* .value holds new absolute count */
+    EVENT_TICK_1HZ,        /* For countdown */
+    EVENT_TICK_FAST,       /* For alarm flashing */
+    EVENT_INACTIVITY,      /* For sleep timeout */
+    EVENT_RECORDER_DUMP,   /* Long press: dump the input recorder */
+    EVENT_SETTINGS_SAVE    /* The dial has been still: commit the settings */
+} event_type_t;
+
+/**
+ * Event posted by producers (timers, button, encoder) to the main loop
+ */
+typedef struct {
+    event_type_t type;
+    int32_t value;
+    uint32_t posted_us;    /* Low 32 bits of hal_mono_us() when posted */
+} app_event_t;
+
+#endif /* APP_EVENT_H */
@@ -16,62 +16,87 @@ static const char *TAG = "buzzer";
 #define BUZZER_LEDC_CHANNEL LEDC_CHANNEL_2 /* BSP backlight uses channel 1 */
 #define BUZZER_LEDC_MODE    LEDC_LOW_SPEED_MODE
 
-/* Single note */
-typedef struct {
-    uint32_t freq_hz;     /* Frequency in Hz */
-    uint32_t duration_ms; /* Duration in milliseconds */
-} buzzer_note_t;
-
-/* Alarm melody: will be played in sequence with no pauses */
-static const buzzer_note_t s_melody[] = {
-    { 587,  326 },  /* D5 quarter */
-    { 698,  489 },  /* F5 dotted quarter */
-    { 784,  163 },  /* G5 eighth */
-    { 659,  163 },  /* E5 eighth */
-    { 523,  163 },  /* C5 eighth */
-};
-static const size_t s_melody_len = sizeof(s_melody) / sizeof(s_melody[0]);
-
-/* Playback state */
+/* Playback state. Every step is aimed at its offset from s_start_us, so a
+ * late timer callback delays one step but never the rest of the melody. */
 static esp_timer_handle_t s_melody_timer = NULL;
-static size_t s_note_index = 0;
+static melody_cursor_t s_cursor;
+static int64_t s_start_us = 0;
 static bool s_playing = false;
+static bool s_fading = false;
 
 /**
- * Set the buzzer frequency and enable output.
+ * Stop the buzzer output (set duty to 0).
  */
-static void set_note(uint32_t freq_hz) {
-    ledc_set_freq(BUZZER_LEDC_MODE, BUZZER_LEDC_TIMER, freq_hz);
-    ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, BUZZER_DUTY_50PCT);
+static void silence(void) {
+    ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, 0);
     ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
 }
 
 /**
- * Stop the buzzer output (set duty to 0).
+ * Convert a melody level to duty. 50% duty is the loudest a square wave
+ * gets the buzzer.
  */
-static void silence(void) {
-    ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, 0);
-    ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+static uint32_t level_to_duty(uint8_t pct) {
+    return (uint32_t)BUZZER_DUTY_50PCT * pct / 100;
 }
 
 /**
- * Timer callback to advance through melody notes.
+ * Stop a running hardware fade before the duty is changed directly
  */
-static void melody_timer_cb(void *arg) {
-    (void)arg;
+static void fade_cancel(void) {
+    if (s_fading) {
+        ledc_fade_stop(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+        s_fading = false;
+    }
+}
 
-    s_note_index++;
-    if (s_note_index >= s_melody_len) {
-        /* End of melody */
+/**
+ * Start a step: set the frequency and peak duty, and leave the decay to
+ * the LEDC fade hardware so the envelope costs no wakeups.
+ */
+static void play_step(const melody_step_t *step) {
+    fade_cancel();
+    if (step->freq_hz == MELODY_REST) {
+        silence();
+        return;
+    }
+    ledc_set_freq(BUZZER_LEDC_MODE, BUZZER_LEDC_TIMER, step->freq_hz);
+    ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, level_to_duty(step->peak_pct));
+    ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+    if (step->decay_ms > 0 && step->sustain_pct != step->peak_pct) {
+        ledc_set_fade_with_time(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL,
+                                level_to_duty(step->sustain_pct), step->decay_ms);
+        ledc_fade_start(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, LEDC_FADE_NO_WAIT);
+        s_fading = true;
+    }
+}
+
+/**
+ * Play the next step and arm the timer for its end, or finish
+ */
+static void advance(void) {
+    melody_step_t step;
+    if (!melody_next(&s_cursor, &step)) {
+        fade_cancel();
         silence();
         s_playing = false;
         return;
     }
 
-    /* Play next note */
-    const buzzer_note_t *note = &s_melody[s_note_index];
-    set_note(note->freq_hz);
-    esp_timer_start_once(s_melody_timer, note->duration_ms * 1000);
+    play_step(&step);
+    int64_t end_us = s_start_us + (int64_t)(step.start_ms + step.duration_ms) * 1000;
+    int64_t delay_us = end_us - esp_timer_get_time();
+    esp_timer_start_once(s_melody_timer, delay_us > 0 ? (uint64_t)delay_us : 0);
+}
+
+/**
+ * Timer callback: the current step has ended
+ */
+static void melody_timer_cb(void *arg) {
+    (void)arg;
+    if (s_playing) {
+        advance();
+    }
 }
 
 esp_err_t buzzer_init(void) {
@@ -105,6 +130,17 @@ esp_err_t buzzer_init(void) {
         return err;
     }
 
+    /* Hardware duty fades for the note envelopes. The ISR is shared by all
+     * LEDC channels, so it may already be installed. */
+    err = ledc_fade_func_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install LEDC fade: %s", esp_err_to_name(err));
+        return err;
+    }
+    /* The driver allocates a channel's fade state on its first fade. A fade
+     * to the current (zero) duty does that now instead of on the first note. */
+    ledc_set_fade_with_time(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, 0, 0);
+
     /* Create melody timer */
     esp_timer_create_args_t timer_args = {
         .callback = melody_timer_cb,
@@ -122,20 +158,24 @@ esp_err_t buzzer_init(void) {
     return ESP_OK;
 }
 
-void buzzer_play_alarm(void) {
+void buzzer_play(melody_id_t id) {
+    const melody_t *melody = melody_get(id);
+    if (melody == NULL) {
+        ESP_LOGE(TAG, "No melody %d", id);
+        return;
+    }
+
     /* Stop any existing playback */
     if (s_playing) {
         esp_timer_stop(s_melody_timer);
     }
 
-    s_note_index = 0;
+    melody_start(&s_cursor, melody);
+    s_start_us = esp_timer_get_time();
     s_playing = true;
+    advance();
 
-    const buzzer_note_t *note = &s_melody[0];
-    set_note(note->freq_hz);
-    esp_timer_start_once(s_melody_timer, note->duration_ms * 1000);
-
-    ESP_LOGI(TAG, "Melody started");
+    ESP_LOGI(TAG, "Melody '%s' started (%lu ms)", melody->name, (unsigned long)melody_duration_ms(melody));
 }
 
 void buzzer_stop(void) {
@@ -143,6 +183,7 @@ void buzzer_stop(void) {
         esp_timer_stop(s_melody_timer);
         s_playing = false;
     }
+    fade_cancel();
     silence();
     ESP_LOGI(TAG, "Buzzer stopped");
 }
@@ -4,19 +4,25 @@
 #include <esp_err.h>
 #include <stdbool.h>
 
+#include "melody.h"
+
 /**
  * Initialize the buzzer using LEDC PWM.
- * Configures GPIO 3 for PWM output and creates the melody timer.
+ * Configures GPIO 3 for PWM output, installs the LEDC fade service and
+ * creates the melody timer.
  *
  * @return ESP_OK on success
  */
 esp_err_t buzzer_init(void);
 
 /**
- * Start playing the alarm melody (non-blocking).
- * The melody plays through automatically using an esp_timer.
+ * Start playing a melody (non-blocking), replacing any melody in progress.
+ * Notes are switched from an esp_timer callback, one wakeup per note or
+ * rest; the volume envelope runs on the LEDC fade hardware.
+ *
+ * @param id  Melody to play, see melody.h
  */
-void buzzer_play_alarm(void);
+void buzzer_play(melody_id_t id);
 
 /**
  * Stop the buzzer immediately.
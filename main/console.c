@@ -0,0 +1,186 @@
+#include "console.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "view.h"
+#include "event_bus.h"
+#include "latency.h"
+
+/* Timers listed by the timers command */
+#define CONSOLE_MAX_TIMERS  8
+
+/**
+ * Parse a whole-number argument
+ */
+static bool parse_int(const char *text, long min, long max, long *value) {
+    char *end;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || v < min || v > max) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+int console_cmd_tasks(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    hal_report_tasks(out);
+    return 0;
+}
+
+int console_cmd_mem(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    hal_report_memory(out);
+    return 0;
+}
+
+int console_cmd_bus(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    static const char *const ring_names[EVENT_BUS_RING_COUNT] = { "button", "timer" };
+    event_bus_stats_t stats;
+    event_bus_get_stats(&stats);
+    for (size_t i = 0; i < EVENT_BUS_RING_COUNT; i++) {
+        const event_bus_ring_stats_t *ring = &stats.rings[i];
+        fprintf(out, "%-8s %8" PRIu32 " posted %6" PRIu32 " dropped  high water %" PRIu32 "/%" PRIu32 "\n",
+                ring_names[i], ring->posted, ring->dropped, ring->high_water, ring->depth);
+    }
+    fprintf(out, "%-8s %8" PRIu32 " posted %6" PRIu32 " coalesced\n",
+            "encoder", stats.encoder_posted, stats.encoder_coalesced);
+    return 0;
+}
+
+int console_cmd_frames(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    /* The LVGL task updates both under the display lock; print outside it */
+    view_flush_stats_t flush;
+    latency_summary_t sums[LATENCY_STAGE_COUNT];
+    hal_display_lock();
+    view_get_flush_stats(&flush);
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        latency_get((latency_stage_t)stage, &sums[stage]);
+    }
+    hal_display_unlock();
+
+    fprintf(out, "frames   %" PRIu32 ", render avg %" PRIu32 " us, max %" PRIu32 " us, last %" PRIu32 " px\n",
+            flush.frames, flush.frames ? (uint32_t)(flush.total_frame_us / flush.frames) : 0,
+            flush.max_frame_us, flush.last_frame_pixels);
+    fprintf(out, "lvgl     %" PRIu32 " wakes, %" PRIu32 " polls avoided\n", flush.wakes, flush.polls_avoided);
+
+    fprintf(out, "%-8s %8s %9s %9s %9s\n", "latency", "count", "p50 us", "p99 us", "max us");
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        const latency_summary_t *sum = &sums[stage];
+        fprintf(out, "%-8s %8" PRIu32 " %9" PRIu32 " %9" PRIu32 " %9" PRIu32 "\n",
+                latency_stage_name((latency_stage_t)stage), sum->count, sum->p50_us, sum->p99_us, sum->max_us);
+    }
+    return 0;
+}
+
+int console_cmd_timers(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    hal_timer_stats_t stats[CONSOLE_MAX_TIMERS];
+    size_t count = hal_timer_get_stats(stats, CONSOLE_MAX_TIMERS);
+    fprintf(out, "%-12s %8s %12s %12s\n", "timer", "fires", "late avg us", "late max us");
+    for (size_t i = 0; i < count; i++) {
+        const hal_timer_stats_t *t = &stats[i];
+        fprintf(out, "%-12s %8" PRIu32 " %12" PRIu32 " %12" PRIu32 "\n", t->name, t->fires,
+                t->fires ? (uint32_t)(t->late_total_us / t->fires) : 0, t->late_max_us);
+    }
+    return 0;
+}
+
+int console_cmd_bench(FILE *out, int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    hal_display_benchmark(out);
+    return 0;
+}
+
+int console_cmd_press(FILE *out, int argc, char **argv) {
+    (void)out;
+    (void)argc;
+    (void)argv;
+    hal_button_inject();
+    return 0;
+}
+
+int console_cmd_turn(FILE *out, int argc, char **argv) {
+    long detents;
+    if (argc != 2 || !parse_int(argv[1], -1000, 1000, &detents) || detents == 0) {
+        fprintf(out, "usage: turn <detents>\n");
+        return 1;
+    }
+    hal_encoder_inject((int32_t)detents);
+    return 0;
+}
+
+int console_cmd_ff(FILE *out, int argc, char **argv) {
+    long seconds;
+    if (argc != 2 || !parse_int(argv[1], 1, 24 * 3600, &seconds)) {
+        fprintf(out, "usage: ff <seconds>\n");
+        return 1;
+    }
+    hal_time_advance((int64_t)seconds * 1000000);
+    return 0;
+}
+
+int console_cmd_trace(FILE *out, int argc, char **argv) {
+    long seconds = 0;
+    if (argc > 2 || (argc == 2 && !parse_int(argv[1], 1, 3600, &seconds))) {
+        fprintf(out, "usage: trace [seconds]\n");
+        return 1;
+    }
+    hal_trace_drain((uint32_t)seconds * 1000);
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    const char *hint;
+    const char *help;
+    int (*run)(FILE *out, int argc, char **argv);
+} command_t;
+
+#define CONSOLE_ENTRY(name, hint, help) { #name, hint, help, console_cmd_##name },
+static const command_t s_commands[] = {
+    CONSOLE_COMMANDS(CONSOLE_ENTRY)
+};
+#undef CONSOLE_ENTRY
+
+int console_execute(FILE *out, char *line) {
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+    char *save;
+    for (char *word = strtok_r(line, " \t\r\n", &save); word != NULL; word = strtok_r(NULL, " \t\r\n", &save)) {
+        if (argc == CONSOLE_MAX_ARGS) {
+            fprintf(out, "too many arguments\n");
+            return 1;
+        }
+        argv[argc++] = word;
+    }
+    if (argc == 0) {
+        return 0;
+    }
+
+    if (strcmp(argv[0], "help") == 0) {
+        for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+            const command_t *cmd = &s_commands[i];
+            fprintf(out, "%s %s\n  %s\n", cmd->name, cmd->hint ? cmd->hint : "", cmd->help);
+        }
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+        if (strcmp(argv[0], s_commands[i].name) == 0) {
+            return s_commands[i].run(out, argc, argv);
+        }
+    }
+    fprintf(out, "unknown command: %s (try help)\n", argv[0]);
+    return -1;
+}
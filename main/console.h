@@ -0,0 +1,45 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdio.h>
+
+/*
+ * Runtime command console.
+ *
+ * The commands only use the HAL and the portable modules, so the same set
+ * runs on the device (registered with esp_console over USB Serial/JTAG by
+ * hal_esp.c) and in the simulator (a pty, see host/sim_console.c).
+ * Commands write their output to out and return 0 on success, non-zero on
+ * bad arguments.
+ *
+ * X(name, hint, help)
+ */
+#define CONSOLE_COMMANDS(X) \
+    X(tasks,  NULL,        "Per task CPU usage since the last call, and stack high water") \
+    X(mem,    NULL,        "Heap and LVGL memory") \
+    X(bus,    NULL,        "Event bus rings: posted, dropped, high water") \
+    X(frames, NULL,        "Frame render times and input-to-panel latency") \
+    X(timers, NULL,        "Timer fires and lateness") \
+    X(bench,  NULL,        "Render worst-case scenes, report frame rate and flush time") \
+    X(press,  NULL,        "Inject a button click") \
+    X(turn,   "<detents>", "Inject an encoder turn, negative for counter-clockwise") \
+    X(ff,     "<seconds>", "Fast-forward the clock") \
+    X(trace,  "[seconds]", "Print the trace ring, then keep printing new records for that long")
+
+#define CONSOLE_DECLARE(name, hint, help) int console_cmd_##name(FILE *out, int argc, char **argv);
+CONSOLE_COMMANDS(CONSOLE_DECLARE)
+#undef CONSOLE_DECLARE
+
+/* Longest command line console_execute() splits, in words */
+#define CONSOLE_MAX_ARGS  8
+
+/**
+ * Split a command line into words and run the matching command. "help"
+ * lists the commands. For consoles without esp_console (the simulator).
+ *
+ * @param line  Modified in place
+ * @return Command result, 0 for an empty line, -1 if the command is unknown
+ */
+int console_execute(FILE *out, char *line);
+
+#endif /* CONSOLE_H */
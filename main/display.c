@@ -0,0 +1,366 @@
+#include "display.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <bsp/esp-bsp.h>
+#include <driver/spi_master.h>
+#include <esp_lcd_gc9a01.h>
+#include <esp_lcd_panel_ops.h>
+#include <esp_lcd_panel_io.h>
+#include <esp_lcd_panel_commands.h>
+#include <esp_lvgl_port.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lvgl_private.h>
+
+#include "latency.h"
+
+static const char *TAG = "display";
+
+/* LVGL draw buffers (Tea Timer > Display in menuconfig), in internal DMA
+ * memory. With two, LVGL renders the next band while the previous one is
+ * still on the bus. */
+#define DISPLAY_DRAW_BUF_LINES CONFIG_TEA_DISPLAY_BUF_LINES
+#define DISPLAY_DRAW_BUF_SIZE  (BSP_LCD_H_RES * DISPLAY_DRAW_BUF_LINES)
+#define DISPLAY_SPI_CLOCK_HZ   (CONFIG_TEA_DISPLAY_SPI_MHZ * 1000 * 1000)
+
+/* Panel command and parameter width, as the BSP sets them */
+#define PANEL_CMD_BITS         8
+#define PANEL_PARAM_BITS       8
+/* Queued SPI transactions: an area plus its window commands */
+#define PANEL_TRANS_QUEUE      10
+
+/* Render on demand: longest the LVGL task blocks without a timer due, and
+ * the period of the port's tick interrupt, which LVGL no longer reads */
+#define DISPLAY_IDLE_WAKE_MS   (10 * 1000)
+
+/* The M5Dial's GC9A01 shows true colors with inversion on */
+#define PANEL_INVERT           true
+
+/* GC9A01 needs 5ms after SLPOUT before it accepts further commands */
+#define PANEL_SLPOUT_DELAY_MS  5
+
+/* Benchmark: frames rendered per scene and buffering */
+#define BENCH_FRAMES           60
+#define BENCH_ARC_WIDTH        20
+
+static esp_lcd_panel_handle_t s_panel = NULL;
+static esp_lcd_panel_io_handle_t s_io = NULL;
+static lv_display_t *s_disp = NULL;
+
+/* Bus accounting: areas handed to the panel, areas fully sent and the time
+ * they spent in flight */
+static uint32_t s_transfer_start_us = 0;
+static atomic_uint_fast32_t s_transfers_started = 0;
+static atomic_uint_fast32_t s_transfers_done = 0;
+static atomic_uint_fast32_t s_transfer_total_us = 0;
+
+/**
+ * Panel IO transfer-done callback (ISR context), in place of the one the
+ * LVGL port registers: the same flush-ready signal, plus the time the last
+ * pixels of an area left for the panel, for the latency histograms.
+ */
+static bool flush_io_ready_cb(esp_lcd_panel_io_handle_t io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx) {
+    (void)io;
+    (void)edata;
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    latency_flush_done(now_us);
+    atomic_fetch_add(&s_transfer_total_us, now_us - s_transfer_start_us);
+    atomic_fetch_add(&s_transfers_done, 1);
+    lv_display_flush_ready((lv_display_t *)user_ctx);
+    return false;
+}
+
+/**
+ * LVGL is about to hand an area to the panel. The previous transfer has
+ * completed by now, with either buffering.
+ */
+static void flush_start_cb(lv_event_t *e) {
+    (void)e;
+    s_transfer_start_us = (uint32_t)esp_timer_get_time();
+    atomic_fetch_add(&s_transfers_started, 1);
+}
+
+/**
+ * SPI bus, panel IO and GC9A01 driver, as bsp_display_new() sets them up
+ * but with the clock from the configuration
+ */
+static esp_err_t panel_new(void) {
+    const spi_bus_config_t bus_cfg = {
+        .sclk_io_num = BSP_LCD_PCLK,
+        .mosi_io_num = BSP_LCD_DATA0,
+        .miso_io_num = GPIO_NUM_NC,
+        .quadwp_io_num = GPIO_NUM_NC,
+        .quadhd_io_num = GPIO_NUM_NC,
+        .max_transfer_sz = DISPLAY_DRAW_BUF_SIZE * sizeof(uint16_t),
+        /* Transfer-done interrupts on the core LVGL renders on */
+        .isr_cpu_id = CONFIG_TEA_LVGL_TASK_CORE < 0 ? ESP_INTR_CPU_AFFINITY_AUTO
+                                                    : ESP_INTR_CPU_AFFINITY_0 + CONFIG_TEA_LVGL_TASK_CORE,
+    };
+    esp_err_t err = spi_bus_initialize(BSP_LCD_SPI_NUM, &bus_cfg, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const esp_lcd_panel_io_spi_config_t io_cfg = {
+        .dc_gpio_num = BSP_LCD_DC,
+        .cs_gpio_num = BSP_LCD_CS,
+        .pclk_hz = DISPLAY_SPI_CLOCK_HZ,
+        .lcd_cmd_bits = PANEL_CMD_BITS,
+        .lcd_param_bits = PANEL_PARAM_BITS,
+        .spi_mode = 0,
+        .trans_queue_depth = PANEL_TRANS_QUEUE,
+    };
+    err = esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)BSP_LCD_SPI_NUM, &io_cfg, &s_io);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const esp_lcd_panel_dev_config_t panel_cfg = {
+        .reset_gpio_num = BSP_LCD_RST,
+        .rgb_ele_order = BSP_LCD_COLOR_SPACE,
+        .bits_per_pixel = BSP_LCD_BITS_PER_PIXEL,
+    };
+    err = esp_lcd_new_panel_gc9a01(s_io, &panel_cfg, &s_panel);
+    if (err != ESP_OK) {
+        return err;
+    }
+    esp_lcd_panel_reset(s_panel);
+    esp_lcd_panel_init(s_panel);
+    esp_lcd_panel_invert_color(s_panel, PANEL_INVERT);
+    return ESP_OK;
+}
+
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+/**
+ * LVGL tick straight from esp_timer, so no interrupt has to count it
+ */
+static uint32_t tick_get_cb(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+#endif
+
+lv_display_t *display_start(void) {
+    lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    port_cfg.task_priority = CONFIG_TEA_LVGL_TASK_PRIO;
+    port_cfg.task_affinity = CONFIG_TEA_LVGL_TASK_CORE;
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+    /* The task sleeps until LVGL has a timer due or view_kick() wakes it */
+    port_cfg.task_max_sleep_ms = DISPLAY_IDLE_WAKE_MS;
+    port_cfg.timer_period_ms = DISPLAY_IDLE_WAKE_MS;
+#endif
+    esp_err_t err = lvgl_port_init(&port_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "lvgl_port_init() failed: %s", esp_err_to_name(err));
+        return NULL;
+    }
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+    lv_tick_set_cb(tick_get_cb);
+#endif
+
+    err = bsp_display_brightness_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Backlight init failed: %s", esp_err_to_name(err));
+        return NULL;
+    }
+
+    err = panel_new();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Panel init failed: %s", esp_err_to_name(err));
+        return NULL;
+    }
+    esp_lcd_panel_disp_on_off(s_panel, true);
+
+    const lvgl_port_display_cfg_t disp_cfg = {
+        .io_handle = s_io,
+        .panel_handle = s_panel,
+        .buffer_size = DISPLAY_DRAW_BUF_SIZE,
+#if CONFIG_TEA_DISPLAY_DOUBLE_BUFFER
+        .double_buffer = true,
+#else
+        .double_buffer = false,
+#endif
+        .hres = BSP_LCD_H_RES,
+        .vres = BSP_LCD_V_RES,
+        .monochrome = false,
+        .rotation = {
+            .swap_xy = false,
+            .mirror_x = false,
+            .mirror_y = false,
+        },
+        .flags = {
+            .buff_dma = true,
+            .buff_spiram = false,
+            .swap_bytes = true,  /* Panel expects big-endian RGB565 over SPI */
+        },
+    };
+    s_disp = lvgl_port_add_disp(&disp_cfg);
+    if (s_disp == NULL) {
+        ESP_LOGE(TAG, "lvgl_port_add_disp() failed");
+        return NULL;
+    }
+
+    const esp_lcd_panel_io_callbacks_t io_cbs = {
+        .on_color_trans_done = flush_io_ready_cb,
+    };
+    ESP_ERROR_CHECK(esp_lcd_panel_io_register_event_callbacks(s_io, &io_cbs, s_disp));
+    lv_display_add_event_cb(s_disp, flush_start_cb, LV_EVENT_FLUSH_START, NULL);
+
+    ESP_LOGI(TAG, "Panel at %d MHz, %s %d-line draw buffer%s", CONFIG_TEA_DISPLAY_SPI_MHZ,
+             s_disp->buf_2 != NULL ? "two" : "one", DISPLAY_DRAW_BUF_LINES, s_disp->buf_2 != NULL ? "s" : "");
+    return s_disp;
+}
+
+void display_sleep(void) {
+    /* Stop LVGL first; holding the lock guarantees no flush is in flight */
+    lvgl_port_stop();
+    bsp_display_lock(0);
+    esp_lcd_panel_disp_on_off(s_panel, false);
+    esp_lcd_panel_io_tx_param(s_io, LCD_CMD_SLPIN, NULL, 0);
+    bsp_display_unlock();
+}
+
+void display_wake(void) {
+    bsp_display_lock(0);
+    esp_lcd_panel_io_tx_param(s_io, LCD_CMD_SLPOUT, NULL, 0);
+    vTaskDelay(pdMS_TO_TICKS(PANEL_SLPOUT_DELAY_MS));
+    esp_lcd_panel_disp_on_off(s_panel, true);
+    bsp_display_unlock();
+    lvgl_port_resume();
+}
+
+void display_refresh_now(void) {
+    lv_refr_now(s_disp);
+}
+
+void display_invert(bool inverted) {
+    esp_lcd_panel_invert_color(s_panel, inverted != PANEL_INVERT);
+}
+
+/**
+ * Scene step: full-screen flash, alternating the background of the whole
+ * screen as the alarm does
+ */
+static void bench_flash_step(lv_obj_t *screen, lv_obj_t *arc, uint32_t frame) {
+    (void)arc;
+    lv_obj_set_style_bg_color(screen, (frame & 1) ? lv_color_hex(0xF44336) : lv_color_hex(0x000000), 0);
+}
+
+/**
+ * Scene step: sweep the indicator of a full-size arc around, a tenth of the
+ * circle per frame
+ */
+static void bench_arc_step(lv_obj_t *screen, lv_obj_t *arc, uint32_t frame) {
+    (void)screen;
+    lv_arc_set_value(arc, (int32_t)((frame * 10) % 110));
+}
+
+/**
+ * Scene step: the alarm flash done by the panel, inverting what is already
+ * on it. Nothing is rendered or sent but the command.
+ */
+static void bench_invert_step(lv_obj_t *screen, lv_obj_t *arc, uint32_t frame) {
+    (void)screen;
+    (void)arc;
+    display_invert((frame & 1) != 0);
+}
+
+typedef struct {
+    const char *name;
+    void (*step)(lv_obj_t *screen, lv_obj_t *arc, uint32_t frame);
+    bool renders;  /* false: the draw buffers play no part, run once */
+} bench_scene_t;
+
+static const bench_scene_t s_bench_scenes[] = {
+    { "flash",  bench_flash_step,  true },
+    { "invert", bench_invert_step, false },
+    { "arc",    bench_arc_step,    true },
+};
+
+/**
+ * Wait until the last area handed to the panel has left the bus. With two
+ * buffers, lv_refr_now() returns while it is still in flight.
+ */
+static void transfers_wait(void) {
+    while (atomic_load(&s_transfers_done) != atomic_load(&s_transfers_started)) {
+        taskYIELD();
+    }
+}
+
+/**
+ * Render BENCH_FRAMES frames of one scene and print the rates. The display
+ * lock is held throughout, so the LVGL task does not refresh in between.
+ */
+static void bench_run(FILE *out, const bench_scene_t *scene, const char *buffering,
+                      lv_obj_t *screen, lv_obj_t *arc) {
+    bsp_display_lock(0);
+    transfers_wait();
+    uint32_t transfers = atomic_load(&s_transfers_done);
+    uint32_t transfer_us = atomic_load(&s_transfer_total_us);
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+        scene->step(screen, arc, frame);
+        lv_refr_now(s_disp);
+    }
+    transfers_wait();
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    transfers = atomic_load(&s_transfers_done) - transfers;
+    transfer_us = atomic_load(&s_transfer_total_us) - transfer_us;
+    bsp_display_unlock();
+
+    uint32_t fps_x10 = (uint32_t)(BENCH_FRAMES * 10000000ULL / elapsed_us);
+    fprintf(out, "%-6s %-7s %6" PRIu32 ".%" PRIu32 " %9" PRIu32 " %9" PRIu32 " %6" PRIu32 " %5" PRIu32 "%%\n",
+            scene->name, buffering, fps_x10 / 10, fps_x10 % 10, elapsed_us / BENCH_FRAMES,
+            transfer_us / BENCH_FRAMES, transfers / BENCH_FRAMES, (uint32_t)(transfer_us * 100ULL / elapsed_us));
+}
+
+void display_benchmark(FILE *out) {
+    bsp_display_lock(0);
+    lv_obj_t *previous = lv_screen_active();
+    lv_obj_t *screen = lv_obj_create(NULL);
+    lv_obj_set_style_bg_color(screen, lv_color_hex(0x000000), 0);
+    lv_obj_t *arc = lv_arc_create(screen);
+    lv_obj_set_size(arc, BSP_LCD_H_RES, BSP_LCD_V_RES);
+    lv_obj_center(arc);
+    lv_arc_set_range(arc, 0, 100);
+    lv_arc_set_bg_angles(arc, 0, 360);
+    lv_arc_set_rotation(arc, 270);
+    lv_obj_remove_style(arc, NULL, LV_PART_KNOB);
+    lv_obj_set_style_arc_width(arc, BENCH_ARC_WIDTH, LV_PART_MAIN);
+    lv_obj_set_style_arc_width(arc, BENCH_ARC_WIDTH, LV_PART_INDICATOR);
+    lv_screen_load(screen);
+    lv_refr_now(s_disp);
+
+    lv_draw_buf_t *buf_1 = s_disp->buf_1;
+    lv_draw_buf_t *buf_2 = s_disp->buf_2;
+    bsp_display_unlock();
+
+    fprintf(out, "panel %d MHz, %d-line buffers, %d frames per run\n",
+            CONFIG_TEA_DISPLAY_SPI_MHZ, DISPLAY_DRAW_BUF_LINES, BENCH_FRAMES);
+    fprintf(out, "%-6s %-7s %8s %9s %9s %6s %6s\n", "scene", "buffers", "fps", "frame us", "flush us", "areas", "bus");
+    for (size_t i = 0; i < sizeof(s_bench_scenes) / sizeof(s_bench_scenes[0]); i++) {
+        if (!s_bench_scenes[i].renders) {
+            bench_run(out, &s_bench_scenes[i], "-", screen, arc);
+            bsp_display_lock(0);
+            display_invert(false);
+            bsp_display_unlock();
+            continue;
+        }
+        if (buf_2 != NULL) {
+            bench_run(out, &s_bench_scenes[i], "double", screen, arc);
+            bsp_display_lock(0);
+            lv_display_set_draw_buffers(s_disp, buf_1, NULL);
+            bsp_display_unlock();
+        }
+        bench_run(out, &s_bench_scenes[i], "single", screen, arc);
+        bsp_display_lock(0);
+        lv_display_set_draw_buffers(s_disp, buf_1, buf_2);
+        bsp_display_unlock();
+    }
+
+    bsp_display_lock(0);
+    lv_screen_load(previous);
+    lv_obj_delete(screen);
+    bsp_display_unlock();
+}
@@ -0,0 +1,54 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdio.h>
+#include <lvgl.h>
+
+/**
+ * Bring up the GC9A01 panel and the LVGL port.
+ * Equivalent to bsp_display_start() minus the touch input device, which this
+ * application does not use, but keeps the panel handles so the panel can be
+ * put to sleep, and takes the SPI clock, the draw buffers and render on
+ * demand from the configuration (Tea Timer > Display).
+ *
+ * @return LVGL display, or NULL on failure
+ */
+lv_display_t *display_start(void);
+
+/**
+ * Pause LVGL and put the panel into sleep mode (DISPOFF + SLPIN).
+ * The panel keeps its frame memory, so the last frame reappears on wake.
+ */
+void display_sleep(void);
+
+/**
+ * Take the panel out of sleep mode and resume LVGL.
+ */
+void display_wake(void);
+
+/**
+ * Render and flush any pending invalidated areas immediately instead of
+ * waiting for the next LVGL refresh period.
+ * Caller MUST hold the display lock before calling.
+ */
+void display_refresh_now(void);
+
+/**
+ * Invert the colors of everything on the panel (INVON / INVOFF), without
+ * rendering or sending a frame. Used for the alarm flash.
+ * Caller MUST hold the display lock before calling.
+ *
+ * @param inverted  true = inverted, false = true colors
+ */
+void display_invert(bool inverted);
+
+/**
+ * Render worst-case scenes (full-screen flash, arc sweep) on a scratch
+ * screen, with two draw buffers and with one, and the panel-inverted flash,
+ * and print frames (or flash phases) per second and time on the bus for
+ * each. The application's screen is restored
+ * afterwards. Takes the display lock itself; a few seconds.
+ */
+void display_benchmark(FILE *out);
+
+#endif /* DISPLAY_H */
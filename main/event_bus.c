@@ -0,0 +1,146 @@
+#include "event_bus.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+_Static_assert((EVENT_BUS_BUTTON_DEPTH & (EVENT_BUS_BUTTON_DEPTH - 1)) == 0, "depth must be a power of two");
+_Static_assert((EVENT_BUS_TIMER_DEPTH & (EVENT_BUS_TIMER_DEPTH - 1)) == 0, "depth must be a power of two");
+
+/**
+ * SPSC ring. head and tail count up freely and are masked on access, so
+ * tail - head is the fill level even across wrap-around.
+ */
+typedef struct {
+    app_event_t *slots;
+    uint32_t mask;
+    atomic_uint_fast32_t head;  /* Written by the consumer */
+    atomic_uint_fast32_t tail;  /* Written by the producer */
+    atomic_uint_fast32_t posted;
+    atomic_uint_fast32_t dropped;
+    atomic_uint_fast32_t high_water;
+} ring_t;
+
+static app_event_t s_button_slots[EVENT_BUS_BUTTON_DEPTH];
+static app_event_t s_timer_slots[EVENT_BUS_TIMER_DEPTH];
+
+static ring_t s_rings[EVENT_BUS_RING_COUNT] = {
+    [EVENT_BUS_RING_BUTTON] = { .slots = s_button_slots, .mask = EVENT_BUS_BUTTON_DEPTH - 1 },
+    [EVENT_BUS_RING_TIMER]  = { .slots = s_timer_slots,  .mask = EVENT_BUS_TIMER_DEPTH - 1 },
+};
+
+/* Encoder coalescing slot: latest absolute count plus a pending flag. The
+ * timestamp is the oldest update still pending, i.e. the one the user has
+ * been waiting for the longest. Posters are serialized by the HAL, so like
+ * the rings it has one producer at a time. */
+static atomic_int_fast32_t s_encoder_count;
+static atomic_uint_fast32_t s_encoder_posted_us;
+static atomic_bool s_encoder_pending;
+static atomic_uint_fast32_t s_encoder_posted;
+static atomic_uint_fast32_t s_encoder_coalesced;
+
+void event_bus_init(void) {
+    for (size_t i = 0; i < EVENT_BUS_RING_COUNT; i++) {
+        ring_t *ring = &s_rings[i];
+        atomic_store(&ring->head, 0);
+        atomic_store(&ring->tail, 0);
+        atomic_store(&ring->posted, 0);
+        atomic_store(&ring->dropped, 0);
+        atomic_store(&ring->high_water, 0);
+    }
+    atomic_store(&s_encoder_count, 0);
+    atomic_store(&s_encoder_posted_us, 0);
+    atomic_store(&s_encoder_pending, false);
+    atomic_store(&s_encoder_posted, 0);
+    atomic_store(&s_encoder_coalesced, 0);
+}
+
+static bool ring_push(ring_t *ring, const app_event_t *evt) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t used = tail - head;
+    if (used > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->slots[tail & ring->mask] = *evt;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    /* Only this producer writes the counters, so no read-modify-write race */
+    atomic_fetch_add_explicit(&ring->posted, 1, memory_order_relaxed);
+    if (used + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+static bool ring_pop(ring_t *ring, app_event_t *evt) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *evt = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool event_bus_post(const app_event_t *evt) {
+    switch (evt->type) {
+        case EVENT_ENCODER_CHANGE:
+            /* Count first, then flag, so a consumer that sees the flag also
+             * sees this count (or a newer one) */
+            atomic_store_explicit(&s_encoder_count, evt->value, memory_order_relaxed);
+            if (!atomic_load_explicit(&s_encoder_pending, memory_order_relaxed)) {
+                atomic_store_explicit(&s_encoder_posted_us, evt->posted_us, memory_order_relaxed);
+            }
+            if (atomic_exchange_explicit(&s_encoder_pending, true, memory_order_release)) {
+                atomic_fetch_add_explicit(&s_encoder_coalesced, 1, memory_order_relaxed);
+            }
+            atomic_fetch_add_explicit(&s_encoder_posted, 1, memory_order_relaxed);
+            return true;
+
+        case EVENT_BUTTON_PRESS:
+        case EVENT_RECORDER_DUMP:
+            return ring_push(&s_rings[EVENT_BUS_RING_BUTTON], evt);
+
+        case EVENT_TICK_1HZ:
+        case EVENT_TICK_FAST:
+        case EVENT_INACTIVITY:
+        case EVENT_SETTINGS_SAVE:
+            return ring_push(&s_rings[EVENT_BUS_RING_TIMER], evt);
+
+        default:
+            return false;
+    }
+}
+
+bool event_bus_pop(app_event_t *evt) {
+    for (size_t i = 0; i < EVENT_BUS_RING_COUNT; i++) {
+        if (ring_pop(&s_rings[i], evt)) {
+            return true;
+        }
+    }
+
+    if (atomic_exchange_explicit(&s_encoder_pending, false, memory_order_acquire)) {
+        evt->type = EVENT_ENCODER_CHANGE;
+        evt->value = (int32_t)atomic_load_explicit(&s_encoder_count, memory_order_relaxed);
+        evt->posted_us = (uint32_t)atomic_load_explicit(&s_encoder_posted_us, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void event_bus_get_stats(event_bus_stats_t *stats) {
+    for (size_t i = 0; i < EVENT_BUS_RING_COUNT; i++) {
+        ring_t *ring = &s_rings[i];
+        stats->rings[i] = (event_bus_ring_stats_t){
+            .posted = atomic_load_explicit(&ring->posted, memory_order_relaxed),
+            .dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed),
+            .high_water = atomic_load_explicit(&ring->high_water, memory_order_relaxed),
+            .depth = ring->mask + 1,
+        };
+    }
+    stats->encoder_posted = atomic_load_explicit(&s_encoder_posted, memory_order_relaxed);
+    stats->encoder_coalesced = atomic_load_explicit(&s_encoder_coalesced, memory_order_relaxed);
+}
@@ -0,0 +1,92 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_event.h"
+
+/*
+ * Event bus between the producers (timers, button, encoder ISR) and the
+ * main loop.
+ *
+ * Each producer context has its own lock-free single-producer/single-consumer
+ * ring, so a burst from one producer can never evict another's events:
+ *   - button ring: EVENT_BUTTON_PRESS, EVENT_RECORDER_DUMP, posted from the
+ *                  iot_button timer
+ *   - timer ring:  EVENT_TICK_1HZ, EVENT_TICK_FAST, EVENT_INACTIVITY,
+ *                  EVENT_SETTINGS_SAVE, posted from esp_timer callbacks
+ * Encoder changes carry an absolute count, so they are not queued at all but
+ * coalesced into one slot holding the latest count. The slot is single
+ * producer too: the HAL posts to it from several contexts (watch point ISR,
+ * console, wake), but only under the lock that guards the count, so a count
+ * can never be overwritten by an older one.
+ *
+ * event_bus_pop() drains the button ring first, then the timer ring, then
+ * the encoder slot. The bus does no blocking or signalling; the HAL pairs
+ * it with a semaphore (see hal_event_post() / hal_event_receive()).
+ */
+
+/**
+ * Rings, in delivery priority order
+ */
+typedef enum {
+    EVENT_BUS_RING_BUTTON,
+    EVENT_BUS_RING_TIMER,
+    EVENT_BUS_RING_COUNT
+} event_bus_ring_t;
+
+/**
+ * Ring depths (powers of two). Size them from the high watermarks.
+ */
+#define EVENT_BUS_BUTTON_DEPTH  4
+#define EVENT_BUS_TIMER_DEPTH   8
+
+/**
+ * Per ring counters
+ */
+typedef struct {
+    uint32_t posted;      /* Events accepted */
+    uint32_t dropped;     /* Events rejected because the ring was full */
+    uint32_t high_water;  /* Most events ever waiting in the ring */
+    uint32_t depth;       /* Ring capacity */
+} event_bus_ring_stats_t;
+
+/**
+ * Event bus counters
+ */
+typedef struct {
+    event_bus_ring_stats_t rings[EVENT_BUS_RING_COUNT];
+    uint32_t encoder_posted;     /* Encoder updates posted */
+    uint32_t encoder_coalesced;  /* Updates merged into one still waiting */
+} event_bus_stats_t;
+
+/**
+ * Empty all rings and clear the counters. Not thread safe; call before
+ * any producer is started.
+ */
+void event_bus_init(void);
+
+/**
+ * Post an event to the ring (or encoder slot) for its type.
+ * Lock-free; at most one context may post to each ring.
+ *
+ * @return false if the ring was full and the event was dropped
+ */
+bool event_bus_post(const app_event_t *evt);
+
+/**
+ * Take the next event in priority order. Consumer side, main loop only.
+ *
+ * @param evt  Receives the event
+ * @return false if nothing is pending
+ */
+bool event_bus_pop(app_event_t *evt);
+
+/**
+ * Snapshot of the counters. Safe from any context; the values are read
+ * one at a time, not as an atomic set.
+ */
+void event_bus_get_stats(event_bus_stats_t *stats);
+
+#endif /* EVENT_BUS_H */
@@ -0,0 +1,322 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "app_event.h"
+#include "melody.h"
+
+/*
+ * Thin hardware abstraction used by the application event loop.
+ *
+ * hal_esp.c implements it on top of ESP-IDF and the M5Dial BSP. The host
+ * simulator in host/ provides a Linux implementation driven by a virtual
+ * clock, so the same tea_timer.c can run on a workstation.
+ */
+
+/**
+ * Logging
+ */
+#ifdef ESP_PLATFORM
+#include <esp_log.h>
+#define HAL_LOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#else
+void hal_log(char level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+#define HAL_LOGE(tag, fmt, ...) hal_log('E', tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGW(tag, fmt, ...) hal_log('W', tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGI(tag, fmt, ...) hal_log('I', tag, fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * Storage class for state that must survive sleep and software resets.
+ * Not initialized at boot, so users must validate it themselves.
+ */
+#ifdef ESP_PLATFORM
+#include <esp_attr.h>
+#define HAL_RETAINED RTC_NOINIT_ATTR
+#else
+#define HAL_RETAINED
+#endif
+
+/**
+ * Monotonic time since boot in microseconds, plus any hal_time_advance().
+ */
+int64_t hal_time_us(void);
+
+/**
+ * Monotonic time since boot in microseconds, never moved by
+ * hal_time_advance(). For measuring intervals, such as the latency marks,
+ * which must all come from this one clock.
+ */
+int64_t hal_mono_us(void);
+
+/**
+ * Time from reset until hal_mono_us() started counting, i.e. the ROM and
+ * the bootloader, which the boot clock does not see. -1 when it cannot be
+ * told: only a power-on reset restarts the clock it is taken from, and the
+ * simulator has no bootloader.
+ */
+int64_t hal_boot_loader_us(void);
+
+/**
+ * Fast-forward hal_time_us() (console). On the device this only shifts the
+ * clock the application reads: a running countdown jumps ahead at its next
+ * tick, while armed timers keep their real-time schedule. The simulator
+ * runs its virtual clock forward, firing every timer on the way.
+ */
+void hal_time_advance(int64_t us);
+
+/**
+ * Software timers. Callbacks run in timer task context (not an ISR) and
+ * must only post events.
+ */
+typedef struct hal_timer *hal_timer_t;
+typedef void (*hal_timer_cb_t)(void *arg);
+
+/**
+ * Create a stopped timer.
+ *
+ * @param name  Name for debugging
+ * @param cb    Callback invoked on expiry
+ * @param arg   Argument passed to the callback
+ * @return Timer handle, aborts on failure
+ */
+hal_timer_t hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg);
+
+/**
+ * (Re)start a timer to fire once after timeout_us.
+ */
+void hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us);
+
+/**
+ * (Re)start a timer to fire every period_us.
+ */
+void hal_timer_start_periodic(hal_timer_t timer, uint64_t period_us);
+
+/**
+ * Stop a timer. Does nothing if it is not running.
+ */
+void hal_timer_stop(hal_timer_t timer);
+
+/**
+ * Expiry statistics of one timer. Lateness is measured from the time the
+ * timer was due to the start of its callback.
+ */
+typedef struct {
+    const char *name;
+    uint32_t fires;
+    uint32_t late_max_us;
+    uint64_t late_total_us;
+} hal_timer_stats_t;
+
+/**
+ * Statistics of every timer created so far, in creation order.
+ *
+ * @return Number of entries written, at most max
+ */
+size_t hal_timer_get_stats(hal_timer_stats_t *stats, size_t max);
+
+/**
+ * Set up the event bus (see event_bus.h). Must be called before any
+ * producer is started.
+ *
+ * @return true on success
+ */
+bool hal_event_init(void);
+
+/**
+ * Post an event from task or timer callback context and wake the main loop.
+ * Each event type has a single producer context, see event_bus.h. Stamps
+ * posted_us, so callers need not set it.
+ *
+ * @return false if the ring for the event was full and it was dropped
+ */
+bool hal_event_post(const app_event_t *evt);
+
+/**
+ * Wait for the next event.
+ *
+ * @param evt  Receives the event
+ * @return true when an event was received. Never returns false on the
+ *         device; the simulator returns false once its script has run out.
+ */
+bool hal_event_receive(app_event_t *evt);
+
+/**
+ * Initialize the rotary encoder. Each detent posts EVENT_ENCODER_CHANGE
+ * with the new absolute count.
+ */
+void hal_encoder_init(void);
+
+/**
+ * Current absolute encoder count, including any partial detent.
+ */
+int32_t hal_encoder_get_count(void);
+
+/**
+ * Inject an encoder turn as if the knob had moved (console). Posts
+ * EVENT_ENCODER_CHANGE with the count moved by detents.
+ */
+void hal_encoder_inject(int32_t detents);
+
+/**
+ * Post EVENT_ENCODER_CHANGE with the current count, including any partial
+ * detent, e.g. to wake the logic on an edge that did not complete a detent.
+ * Encoder changes are only ever posted through the HAL, which serializes
+ * them; see event_bus_post().
+ */
+void hal_encoder_post(void);
+
+/**
+ * Initialize the faceplate button. A single click posts EVENT_BUTTON_PRESS,
+ * a long press EVENT_RECORDER_DUMP.
+ */
+void hal_button_init(void);
+
+/**
+ * Inject a button click (console). Posted from the same context as a real
+ * click, so the button ring keeps a single producer.
+ */
+void hal_button_inject(void);
+
+/**
+ * Start the display and the LVGL task.
+ *
+ * @param rotation_deg  UI rotation: 0, 90, 180 or 270
+ * @return true on success
+ */
+bool hal_display_start(int rotation_deg);
+
+/**
+ * Take / release the display (LVGL) lock. Blocks until available.
+ */
+void hal_display_lock(void);
+void hal_display_unlock(void);
+
+/**
+ * Render and flush pending UI changes now rather than on the next LVGL
+ * refresh period. Caller MUST hold the display lock.
+ */
+void hal_display_refresh_now(void);
+
+/**
+ * Switch the display backlight on or off.
+ */
+void hal_backlight_set(bool on);
+
+/**
+ * What ended a hal_sleep_until_input() call
+ */
+typedef enum {
+    HAL_WAKE_NONE,     /* Nothing left to wake for (simulator only) */
+    HAL_WAKE_BUTTON,   /* Faceplate button; its click event follows on release */
+    HAL_WAKE_ENCODER,  /* Encoder edge; not counted as a detent */
+    HAL_WAKE_TIMER,    /* A timer was due first (simulator only) */
+} hal_wake_t;
+
+/**
+ * Put the panel to sleep, pause LVGL and enter light sleep until the button
+ * or the encoder moves. The panel and LVGL are running again on return, and
+ * the panel still shows the frame from before sleep.
+ * The backlight should be off and no timers should be running.
+ *
+ * @return Wake source
+ */
+hal_wake_t hal_sleep_until_input(void);
+
+/**
+ * Buzzer control. See buzzer.h.
+ * The buzzer is initialized on the first hal_buzzer_play_alarm() call, so it
+ * stays off the boot path, except in the zero-heap build (see
+ * hal_heap_freeze()).
+ *
+ * @param melody  Alarm melody, see melody.h
+ */
+void hal_buzzer_play_alarm(melody_id_t melody);
+void hal_buzzer_stop(void);
+
+/**
+ * Persistent storage for the settings record (see settings.h): NVS on the
+ * device, memory in the simulator. The device initializes NVS on the first
+ * call, so the first hal_storage_load() belongs on the boot path. Writes
+ * allocate; the zero-heap build lets through the allocations of the task
+ * that writes, for the duration of the write (see hal_heap_freeze()).
+ *
+ * @return hal_storage_load(): true if a record of exactly size bytes was
+ *         stored. hal_storage_save(): true once the record is in flash.
+ */
+bool hal_storage_load(void *data, size_t size);
+bool hal_storage_save(const void *data, size_t size);
+
+/**
+ * Start draining the trace ring (see trace.h) whenever the CPU is otherwise
+ * idle. Does nothing when tracing is compiled out.
+ */
+void hal_trace_start(void);
+
+/**
+ * Drain the trace ring now and keep draining it for another for_ms, then
+ * return. The idle drain is off while the console is running, so that trace
+ * lines never land in a line being typed; the console trace command drains
+ * through this instead, while the console is not reading.
+ */
+void hal_trace_drain(uint32_t for_ms);
+
+/**
+ * Start the command console (see console.h): esp_console over USB
+ * Serial/JTAG on the device, a pty in the simulator when enabled.
+ */
+void hal_console_start(void);
+
+/**
+ * End of boot. Logs the heap and LVGL pool usage. In the zero-heap build
+ * (CONFIG_TEA_STATIC_ALLOC) it first does the initialization that would
+ * otherwise happen on first use, and from then on any heap allocation
+ * aborts.
+ */
+void hal_heap_freeze(void);
+
+/**
+ * Console reports of platform resources: per task CPU usage and stack high
+ * water marks, and heap / LVGL memory.
+ */
+void hal_report_tasks(FILE *out);
+void hal_report_memory(FILE *out);
+
+/**
+ * Console display benchmark: render worst-case scenes and print the frame
+ * rate and panel bus time. Takes the display lock itself.
+ */
+void hal_display_benchmark(FILE *out);
+
+/**
+ * One-off job run by hal_background_start() or hal_loop_start()
+ */
+typedef void (*hal_job_t)(void);
+
+/**
+ * Run the event loop in a task of its own and return. On the device the
+ * task is pinned to the core and runs at the priority set under Tea Timer >
+ * Tasks, away from the LVGL task. The simulator runs it in place and
+ * returns when the loop does.
+ */
+void hal_loop_start(hal_job_t loop);
+
+/**
+ * Run a job in a background task, on the other core where there is one, and
+ * return immediately. Only one job may be outstanding at a time.
+ */
+void hal_background_start(hal_job_t job);
+
+/**
+ * Wait for the job started by hal_background_start() to finish.
+ */
+void hal_background_join(void);
+
+#endif /* HAL_H */
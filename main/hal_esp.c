@@ -0,0 +1,870 @@
+#include "hal.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bsp/esp-bsp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_console.h>
+#include <esp_rom_sys.h>
+#include <esp_rtc_time.h>
+#include <esp_system.h>
+#include <esp_freertos_hooks.h>
+#include <esp_sleep.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <driver/gpio.h>
+#include <driver/pulse_cnt.h>
+
+#include <lvgl.h>
+#include <iot_button.h>
+#include <button_gpio.h>
+
+#include "logic.h"
+#include "buzzer.h"
+#include "display.h"
+#include "event_bus.h"
+#include "trace.h"
+#include "console.h"
+
+static const char *TAG = "hal";
+
+/* Given by producers after posting to the event bus, taken by the main loop
+ * when the bus is empty */
+static SemaphoreHandle_t s_event_signal = NULL;
+static StaticSemaphore_t s_event_signal_buf;
+
+/* PCNT handles */
+static pcnt_unit_handle_t s_pcnt_unit = NULL;
+
+/* Background job, run on the core the main task does not use */
+#define BACKGROUND_TASK_STACK  4096
+#define BACKGROUND_TASK_PRIO   2
+#define BACKGROUND_TASK_CORE   (portNUM_PROCESSORS > 1 ? 1 : tskNO_AFFINITY)
+static hal_job_t s_background_job = NULL;
+static SemaphoreHandle_t s_background_done = NULL;
+static StaticSemaphore_t s_background_done_buf;
+#if CONFIG_TEA_STATIC_ALLOC
+static StackType_t s_background_stack[BACKGROUND_TASK_STACK];
+static StaticTask_t s_background_tcb;
+#endif
+
+/* Event loop task (Tea Timer > Tasks in menuconfig), -1 for no affinity */
+#define LOOP_TASK_STACK        4096
+#define LOOP_TASK_CORE         (CONFIG_TEA_LOOP_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_TEA_LOOP_TASK_CORE)
+static hal_job_t s_loop = NULL;
+#if CONFIG_TEA_STATIC_ALLOC
+static StackType_t s_loop_stack[LOOP_TASK_STACK];
+static StaticTask_t s_loop_tcb;
+#endif
+
+/* Buzzer is set up on first use; the backlight state is needed to undo the
+ * effect its LEDC setup can have on the backlight */
+static bool s_buzzer_ready = false;
+static bool s_backlight_on = false;
+
+/* Detent count accumulated in the watch point ISR. The hardware counter only
+ * spans one detent and is cleared each time it reaches a limit, so this is the
+ * real position and never overflows the 16-bit unit. */
+static volatile int32_t s_encoder_accum = 0;
+/* Guards s_encoder_accum and posting it, which happen in the watch point ISR,
+ * the console and the event loop */
+static portMUX_TYPE s_encoder_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Console fast-forward, added to the esp_timer clock */
+static atomic_int_fast64_t s_time_offset_us;
+
+/* Fires in the esp_timer task, where the button callbacks run too */
+static esp_timer_handle_t s_button_inject_timer = NULL;
+
+/* HAL timers wrap an esp_timer to measure how late each expiry is */
+#define HAL_MAX_TIMERS  8
+struct hal_timer {
+    esp_timer_handle_t handle;
+    const char *name;
+    hal_timer_cb_t cb;
+    void *arg;
+    int64_t due_us;       /* Next expiry on the esp_timer clock */
+    uint64_t period_us;   /* 0 for one-shot */
+    uint32_t fires;
+    uint32_t late_max_us;
+    uint64_t late_total_us;
+};
+static struct hal_timer s_timers[HAL_MAX_TIMERS];
+static size_t s_timer_count = 0;
+
+int64_t hal_time_us(void) {
+    return esp_timer_get_time() + atomic_load_explicit(&s_time_offset_us, memory_order_relaxed);
+}
+
+int64_t hal_mono_us(void) {
+    return esp_timer_get_time();
+}
+
+int64_t hal_boot_loader_us(void) {
+    /* The RTC timer runs from power-on, esp_timer from IDF startup */
+    if (esp_reset_reason() != ESP_RST_POWERON) {
+        return -1;
+    }
+    return (int64_t)esp_rtc_get_time_us() - esp_timer_get_time();
+}
+
+void hal_time_advance(int64_t us) {
+    atomic_fetch_add_explicit(&s_time_offset_us, us, memory_order_relaxed);
+}
+
+static void timer_dispatch(void *arg) {
+    hal_timer_t timer = arg;
+    int64_t late_us = esp_timer_get_time() - timer->due_us;
+    if (late_us < 0) {
+        late_us = 0;
+    }
+    timer->fires++;
+    timer->late_total_us += (uint64_t)late_us;
+    if ((uint32_t)late_us > timer->late_max_us) {
+        timer->late_max_us = (uint32_t)late_us;
+    }
+    if (timer->period_us != 0) {
+        timer->due_us += (int64_t)timer->period_us;
+    }
+    timer->cb(timer->arg);
+}
+
+hal_timer_t hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg) {
+    if (s_timer_count >= HAL_MAX_TIMERS) {
+        ESP_LOGE(TAG, "Too many timers");
+        abort();
+    }
+    hal_timer_t timer = &s_timers[s_timer_count];
+    *timer = (struct hal_timer){ .name = name, .cb = cb, .arg = arg };
+
+    const esp_timer_create_args_t args = {
+        .callback = timer_dispatch,
+        .arg = timer,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = name
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &timer->handle));
+    s_timer_count++;
+    return timer;
+}
+
+void hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us) {
+    esp_timer_stop(timer->handle);  /* Fails harmlessly if not running */
+    timer->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+    timer->period_us = 0;
+    esp_timer_start_once(timer->handle, timeout_us);
+}
+
+void hal_timer_start_periodic(hal_timer_t timer, uint64_t period_us) {
+    esp_timer_stop(timer->handle);
+    timer->due_us = esp_timer_get_time() + (int64_t)period_us;
+    timer->period_us = period_us;
+    esp_timer_start_periodic(timer->handle, period_us);
+}
+
+void hal_timer_stop(hal_timer_t timer) {
+    esp_timer_stop(timer->handle);
+}
+
+size_t hal_timer_get_stats(hal_timer_stats_t *stats, size_t max) {
+    size_t count = s_timer_count < max ? s_timer_count : max;
+    for (size_t i = 0; i < count; i++) {
+        const struct hal_timer *t = &s_timers[i];
+        stats[i] = (hal_timer_stats_t){
+            .name = t->name,
+            .fires = t->fires,
+            .late_max_us = t->late_max_us,
+            .late_total_us = t->late_total_us,
+        };
+    }
+    return count;
+}
+
+bool hal_event_init(void) {
+    event_bus_init();
+    s_event_signal = xSemaphoreCreateBinaryStatic(&s_event_signal_buf);
+    return s_event_signal != NULL;
+}
+
+bool hal_event_post(const app_event_t *evt) {
+    app_event_t stamped = *evt;
+    stamped.posted_us = (uint32_t)hal_mono_us();
+    if (!event_bus_post(&stamped)) {
+        return false;
+    }
+    xSemaphoreGive(s_event_signal);
+    return true;
+}
+
+bool hal_event_receive(app_event_t *evt) {
+    /* A post between the empty check and the take leaves the semaphore
+     * given, so no wakeup is lost */
+    while (!event_bus_pop(evt)) {
+        xSemaphoreTake(s_event_signal, portMAX_DELAY);
+    }
+    return true;
+}
+
+/**
+ * PCNT watch point callback (ISR context) - fires once per detent.
+ * The counter has just reached +/-LOGIC_ENCODER_DIVISOR and been cleared by
+ * hardware, so fold that into the 32-bit count and post it to the encoder
+ * slot of the event bus, where a fast spin coalesces into one update.
+ */
+static bool encoder_watch_cb(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx) {
+    (void)unit;
+    (void)user_ctx;
+    app_event_t evt = { .type = EVENT_ENCODER_CHANGE, .posted_us = (uint32_t)hal_mono_us() };
+    portENTER_CRITICAL_ISR(&s_encoder_mux);
+    s_encoder_accum += edata->watch_point_value;
+    evt.value = s_encoder_accum;
+    event_bus_post(&evt);
+    portEXIT_CRITICAL_ISR(&s_encoder_mux);
+
+    BaseType_t high_task_wakeup = pdFALSE;
+    xSemaphoreGiveFromISR(s_event_signal, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+/* Initialize rotary encoder using hardware PCNT */
+void hal_encoder_init(void) {
+    /* Configure PCNT unit: limits are one detent either way, so the unit wraps
+     * back to zero and raises a watch event on every detent */
+    pcnt_unit_config_t unit_config = {
+        .high_limit = LOGIC_ENCODER_DIVISOR,
+        .low_limit = -LOGIC_ENCODER_DIVISOR,
+    };
+    ESP_ERROR_CHECK(pcnt_new_unit(&unit_config, &s_pcnt_unit));
+
+    /* Configure glitch filter (1000ns = 1us) */
+    pcnt_glitch_filter_config_t filter_config = {
+        .max_glitch_ns = 1000,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(s_pcnt_unit, &filter_config));
+
+    /* Configure channel A (edge on GPIO41, level on GPIO40) */
+    pcnt_chan_config_t chan_a_config = {
+        .edge_gpio_num = BSP_ENCODER_A,
+        .level_gpio_num = BSP_ENCODER_B,
+    };
+    pcnt_channel_handle_t pcnt_chan_a = NULL;
+    ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_a_config, &pcnt_chan_a));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_a,
+        PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+        PCNT_CHANNEL_EDGE_ACTION_DECREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_a,
+        PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+        PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+
+    /* Configure channel B (edge on GPIO40, level on GPIO41) for full quadrature */
+    pcnt_chan_config_t chan_b_config = {
+        .edge_gpio_num = BSP_ENCODER_B,
+        .level_gpio_num = BSP_ENCODER_A,
+    };
+    pcnt_channel_handle_t pcnt_chan_b = NULL;
+    ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_b_config, &pcnt_chan_b));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_b,
+        PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+        PCNT_CHANNEL_EDGE_ACTION_INCREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_b,
+        PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+        PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+
+    /* Watch both limits and deliver detents straight to the event bus */
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(s_pcnt_unit, LOGIC_ENCODER_DIVISOR));
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(s_pcnt_unit, -LOGIC_ENCODER_DIVISOR));
+    pcnt_event_callbacks_t cbs = {
+        .on_reach = encoder_watch_cb,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_register_event_callbacks(s_pcnt_unit, &cbs, NULL));
+
+    /* Enable and start */
+    ESP_ERROR_CHECK(pcnt_unit_enable(s_pcnt_unit));
+    ESP_ERROR_CHECK(pcnt_unit_clear_count(s_pcnt_unit));
+    ESP_ERROR_CHECK(pcnt_unit_start(s_pcnt_unit));
+
+    ESP_LOGI(TAG, "Hardware PCNT encoder initialized");
+}
+
+int32_t hal_encoder_get_count(void) {
+    int count = 0;
+    portENTER_CRITICAL(&s_encoder_mux);
+    pcnt_unit_get_count(s_pcnt_unit, &count);
+    int32_t accum = s_encoder_accum + count;
+    portEXIT_CRITICAL(&s_encoder_mux);
+    return accum;
+}
+
+/**
+ * Move the count by delta and post it, in one critical section so that the
+ * posts from the ISR and from tasks reach the encoder slot in count order
+ */
+static void encoder_post(int32_t delta, bool with_partial) {
+    app_event_t evt = { .type = EVENT_ENCODER_CHANGE, .posted_us = (uint32_t)hal_mono_us() };
+    int count = 0;
+    portENTER_CRITICAL(&s_encoder_mux);
+    if (with_partial) {
+        pcnt_unit_get_count(s_pcnt_unit, &count);
+    }
+    s_encoder_accum += delta;
+    evt.value = s_encoder_accum + count;
+    event_bus_post(&evt);
+    portEXIT_CRITICAL(&s_encoder_mux);
+    xSemaphoreGive(s_event_signal);
+}
+
+void hal_encoder_inject(int32_t detents) {
+    encoder_post(detents * LOGIC_ENCODER_DIVISOR, false);
+}
+
+void hal_encoder_post(void) {
+    encoder_post(0, true);
+}
+
+/* Button callback - sends event to queue, no UI code allowed here */
+static void button_press_cb(void *button_handle, void *usr_data) {
+    TRACE(BUTTON, 0, 0);
+    app_event_t evt = { .type = EVENT_BUTTON_PRESS, .value = 0 };
+    hal_event_post(&evt);
+}
+
+/* Long press callback - asks the main loop for a recorder dump */
+static void button_long_press_cb(void *button_handle, void *usr_data) {
+    app_event_t evt = { .type = EVENT_RECORDER_DUMP, .value = 0 };
+    hal_event_post(&evt);
+}
+
+/* Console click, dispatched by esp_timer like the iot_button callbacks */
+static void button_inject_cb(void *arg) {
+    button_press_cb(NULL, arg);
+}
+
+void hal_button_inject(void) {
+    if (s_button_inject_timer != NULL) {
+        esp_timer_start_once(s_button_inject_timer, 0);
+    }
+}
+
+/* Initialize faceplate button */
+void hal_button_init(void) {
+    const button_config_t btn_cfg = {0};  /* Use defaults */
+    const button_gpio_config_t gpio_cfg = {
+        .gpio_num = BSP_BTN_PRESS,
+        .active_level = 0,  /* Active low */
+        .enable_power_save = true,  /* Stop the scan timer while idle and wake on GPIO */
+    };
+
+    button_handle_t btn = NULL;
+    ESP_ERROR_CHECK(iot_button_new_gpio_device(&btn_cfg, &gpio_cfg, &btn));
+    ESP_ERROR_CHECK(iot_button_register_cb(btn, BUTTON_SINGLE_CLICK, NULL, button_press_cb, NULL));
+    ESP_ERROR_CHECK(iot_button_register_cb(btn, BUTTON_LONG_PRESS_START, NULL, button_long_press_cb, NULL));
+
+    const esp_timer_create_args_t inject_args = {
+        .callback = button_inject_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "button_inject",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&inject_args, &s_button_inject_timer));
+
+    ESP_LOGI(TAG, "Faceplate button initialized");
+}
+
+bool hal_display_start(int rotation_deg) {
+    /* Initialize display and start LVGL handling task */
+    lv_display_t *disp = display_start();
+    if (disp == NULL) {
+        ESP_LOGE(TAG, "display_start() failed");
+        return false;
+    }
+
+    switch (rotation_deg) {
+        case 90:  bsp_display_rotate(disp, LV_DISPLAY_ROTATION_90);  break;
+        case 180: bsp_display_rotate(disp, LV_DISPLAY_ROTATION_180); break;
+        case 270: bsp_display_rotate(disp, LV_DISPLAY_ROTATION_270); break;
+        default:  break;
+    }
+    return true;
+}
+
+void hal_display_lock(void) {
+    bsp_display_lock(0);
+}
+
+void hal_display_unlock(void) {
+    bsp_display_unlock();
+}
+
+void hal_display_refresh_now(void) {
+    display_refresh_now();
+}
+
+void hal_display_benchmark(FILE *out) {
+    display_benchmark(out);
+}
+
+void hal_backlight_set(bool on) {
+    s_backlight_on = on;
+    if (on) {
+        bsp_display_backlight_on();
+    } else {
+        bsp_display_backlight_off();
+    }
+}
+
+/**
+ * Arm a GPIO light sleep wakeup for when the pin leaves its current level
+ */
+static void wakeup_on_change(gpio_num_t pin) {
+    gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+
+/* The encoder and button pins (GPIO40-42) are not RTC GPIOs, so they cannot
+ * wake the chip from deep sleep. Light sleep keeps RAM, peripherals and the
+ * LVGL object tree, which also makes resuming much cheaper than a reboot. */
+hal_wake_t hal_sleep_until_input(void) {
+    display_sleep();
+
+    /* The button wakeup is armed by iot_button in power save mode */
+    int enc_a = gpio_get_level(BSP_ENCODER_A);
+    int enc_b = gpio_get_level(BSP_ENCODER_B);
+    wakeup_on_change(BSP_ENCODER_A);
+    wakeup_on_change(BSP_ENCODER_B);
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+    ESP_LOGI(TAG, "Entering light sleep");
+    esp_light_sleep_start();
+    int64_t wake_us = esp_timer_get_time();
+
+    hal_wake_t wake = (gpio_get_level(BSP_ENCODER_A) != enc_a || gpio_get_level(BSP_ENCODER_B) != enc_b)
+                      ? HAL_WAKE_ENCODER : HAL_WAKE_BUTTON;
+    gpio_wakeup_disable(BSP_ENCODER_A);
+    gpio_wakeup_disable(BSP_ENCODER_B);
+
+    display_wake();
+    ESP_LOGI(TAG, "Woke on %s, panel resumed in %lld us",
+             wake == HAL_WAKE_ENCODER ? "encoder" : "button", esp_timer_get_time() - wake_us);
+    return wake;
+}
+
+/**
+ * Initialize the buzzer unless done already
+ */
+static bool buzzer_prepare(void) {
+    if (!s_buzzer_ready) {
+        if (buzzer_init() != ESP_OK) {
+            ESP_LOGE(TAG, "Buzzer init failed");
+            return false;
+        }
+        s_buzzer_ready = true;
+        /* Configuring the buzzer LEDC timer can turn off the backlight */
+        if (s_backlight_on) {
+            bsp_display_backlight_on();
+        }
+    }
+    return true;
+}
+
+void hal_buzzer_play_alarm(melody_id_t melody) {
+    if (buzzer_prepare()) {
+        buzzer_play(melody);
+    }
+}
+
+void hal_buzzer_stop(void) {
+    if (s_buzzer_ready) {
+        buzzer_stop();
+    }
+}
+
+/* Set once the console REPL reads the serial port the trace is printed on */
+static atomic_bool s_console_running;
+
+#if TRACE_LEVEL > 0
+/* Trace flushing. When either core goes idle, its idle hook wakes a low
+ * priority task, unpinned so that it runs on the idle core. The task prints
+ * whatever the ring holds, then waits a while, so that lines go out in
+ * batches rather than one per record. While the console is running the idle
+ * hooks leave the task alone and it only drains for hal_trace_drain(), so
+ * trace lines never land in the middle of a line being typed. */
+#define TRACE_TASK_STACK      3072
+#define TRACE_TASK_PRIO       1
+#define TRACE_FLUSH_PERIOD_MS 100
+static TaskHandle_t s_trace_task = NULL;
+static StackType_t s_trace_stack[TRACE_TASK_STACK];
+static StaticTask_t s_trace_tcb;
+
+/* hal_trace_drain() request: keep draining until this time, then signal */
+static atomic_int_fast64_t s_drain_until_us;
+static atomic_bool s_drain_requested;
+static SemaphoreHandle_t s_drain_done = NULL;
+static StaticSemaphore_t s_drain_done_buf;
+
+static bool trace_idle_hook(void) {
+    if (s_trace_task != NULL && !atomic_load_explicit(&s_console_running, memory_order_relaxed) &&
+        trace_pending()) {
+        xTaskNotifyGive(s_trace_task);
+    }
+    return true;
+}
+
+static void trace_write_stdout(const char *line, size_t len) {
+    fwrite(line, 1, len, stdout);
+}
+
+static void trace_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (;;) {
+            trace_flush(trace_write_stdout);
+            fflush(stdout);
+            if (hal_mono_us() >= atomic_load_explicit(&s_drain_until_us, memory_order_relaxed)) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(TRACE_FLUSH_PERIOD_MS));
+        }
+        if (atomic_exchange_explicit(&s_drain_requested, false, memory_order_relaxed)) {
+            xSemaphoreGive(s_drain_done);
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(TRACE_FLUSH_PERIOD_MS));
+        }
+    }
+}
+
+void hal_trace_start(void) {
+    s_drain_done = xSemaphoreCreateBinaryStatic(&s_drain_done_buf);
+    s_trace_task = xTaskCreateStatic(trace_task, "trace", TRACE_TASK_STACK, NULL, TRACE_TASK_PRIO,
+                                     s_trace_stack, &s_trace_tcb);
+    /* Either core going idle drains the ring: the loop core is
+     * configurable, and a busy core 0 must not starve the trace */
+    for (int cpu = 0; cpu < portNUM_PROCESSORS; cpu++) {
+        ESP_ERROR_CHECK(esp_register_freertos_idle_hook_for_cpu(trace_idle_hook, cpu));
+    }
+}
+
+void hal_trace_drain(uint32_t for_ms) {
+    if (s_trace_task == NULL) {
+        return;
+    }
+    atomic_store_explicit(&s_drain_until_us, hal_mono_us() + (int64_t)for_ms * 1000, memory_order_relaxed);
+    atomic_store_explicit(&s_drain_requested, true, memory_order_relaxed);
+    xTaskNotifyGive(s_trace_task);
+    xSemaphoreTake(s_drain_done, portMAX_DELAY);
+}
+#else
+void hal_trace_start(void) {
+}
+
+void hal_trace_drain(uint32_t for_ms) {
+    (void)for_ms;
+}
+#endif
+
+static void background_task(void *arg) {
+    (void)arg;
+    s_background_job();
+    xSemaphoreGive(s_background_done);
+    vTaskDelete(NULL);
+}
+
+void hal_background_start(hal_job_t job) {
+    s_background_job = job;
+    s_background_done = xSemaphoreCreateBinaryStatic(&s_background_done_buf);
+#if CONFIG_TEA_STATIC_ALLOC
+    bool created = xTaskCreateStaticPinnedToCore(background_task, "background", BACKGROUND_TASK_STACK,
+                                                 NULL, BACKGROUND_TASK_PRIO, s_background_stack,
+                                                 &s_background_tcb, BACKGROUND_TASK_CORE) != NULL;
+#else
+    bool created = xTaskCreatePinnedToCore(background_task, "background", BACKGROUND_TASK_STACK,
+                                           NULL, BACKGROUND_TASK_PRIO, NULL, BACKGROUND_TASK_CORE) == pdPASS;
+#endif
+    if (!created) {
+        /* Out of memory; run the job in place instead */
+        ESP_LOGW(TAG, "Background task not created, running job inline");
+        job();
+        xSemaphoreGive(s_background_done);
+    }
+}
+
+void hal_background_join(void) {
+    if (s_background_done == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_background_done, portMAX_DELAY);
+    s_background_done = NULL;
+}
+
+static void loop_task(void *arg) {
+    (void)arg;
+    s_loop();
+    vTaskDelete(NULL);
+}
+
+void hal_loop_start(hal_job_t loop) {
+    s_loop = loop;
+#if CONFIG_TEA_STATIC_ALLOC
+    bool created = xTaskCreateStaticPinnedToCore(loop_task, "loop", LOOP_TASK_STACK, NULL,
+                                                 CONFIG_TEA_LOOP_TASK_PRIO, s_loop_stack, &s_loop_tcb,
+                                                 LOOP_TASK_CORE) != NULL;
+#else
+    bool created = xTaskCreatePinnedToCore(loop_task, "loop", LOOP_TASK_STACK, NULL,
+                                           CONFIG_TEA_LOOP_TASK_PRIO, NULL, LOOP_TASK_CORE) == pdPASS;
+#endif
+    if (!created) {
+        /* Out of memory; keep the loop in the main task */
+        ESP_LOGW(TAG, "Loop task not created, running in the main task");
+        loop();
+    }
+}
+
+#if CONFIG_TEA_STATIC_ALLOC
+void hal_console_start(void) {
+    ESP_LOGI(TAG, "No console in the zero-heap build");
+}
+#else
+/* Command console: esp_console REPL on the USB Serial/JTAG port, which also
+ * carries the log. Every command in console.h gets a trampoline that sends
+ * its output to stdout. */
+#define CONSOLE_PROMPT  "tea> "
+
+#define CONSOLE_TRAMPOLINE(name, hint, help) \
+    static int repl_##name(int argc, char **argv) { return console_cmd_##name(stdout, argc, argv); }
+CONSOLE_COMMANDS(CONSOLE_TRAMPOLINE)
+#undef CONSOLE_TRAMPOLINE
+
+void hal_console_start(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = CONSOLE_PROMPT;
+    const esp_console_dev_usb_serial_jtag_config_t jtag_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    esp_err_t err = esp_console_new_repl_usb_serial_jtag(&jtag_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Console not started: %s", esp_err_to_name(err));
+        return;
+    }
+
+#define CONSOLE_REGISTER(cmd_name, cmd_hint, cmd_help)                       \
+    do {                                                                     \
+        const esp_console_cmd_t cmd = {                                      \
+            .command = #cmd_name,                                            \
+            .help = cmd_help,                                                \
+            .hint = cmd_hint,                                                \
+            .func = repl_##cmd_name,                                         \
+        };                                                                   \
+        ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));                     \
+    } while (0);
+    CONSOLE_COMMANDS(CONSOLE_REGISTER)
+#undef CONSOLE_REGISTER
+
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+    /* From here on trace lines would interleave with typed input */
+    atomic_store_explicit(&s_console_running, true, memory_order_relaxed);
+}
+#endif
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+/* Task snapshot kept between two reports, so CPU usage covers the interval */
+#define REPORT_MAX_TASKS  24
+static TaskStatus_t s_task_status[REPORT_MAX_TASKS];
+static struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} s_task_prev[REPORT_MAX_TASKS];
+static size_t s_task_prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE s_total_prev = 0;
+
+void hal_report_tasks(FILE *out) {
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_task_status, REPORT_MAX_TASKS, &total);
+    if (count == 0) {
+        fprintf(out, "more than %d tasks\n", REPORT_MAX_TASKS);
+        return;
+    }
+
+    /* Run time counts per core, so a task busy on its core shows 100% */
+    configRUN_TIME_COUNTER_TYPE elapsed = total - s_total_prev;
+    fprintf(out, "%-16s %4s %8s %10s\n", "task", "prio", "cpu %", "stack free");
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *task = &s_task_status[i];
+        configRUN_TIME_COUNTER_TYPE prev = 0;
+        for (size_t j = 0; j < s_task_prev_count; j++) {
+            if (s_task_prev[j].handle == task->xHandle) {
+                prev = s_task_prev[j].run_time;
+                break;
+            }
+        }
+        uint32_t permille = elapsed ? (uint32_t)((uint64_t)(task->ulRunTimeCounter - prev) * 1000 / elapsed) : 0;
+        fprintf(out, "%-16s %4u %6" PRIu32 ".%" PRIu32 " %10u\n", task->pcTaskName, (unsigned)task->uxCurrentPriority,
+                permille / 10, permille % 10, (unsigned)task->usStackHighWaterMark);
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_task_prev[i].handle = s_task_status[i].xHandle;
+        s_task_prev[i].run_time = s_task_status[i].ulRunTimeCounter;
+    }
+    s_task_prev_count = count;
+    s_total_prev = total;
+}
+#else
+void hal_report_tasks(FILE *out) {
+    fprintf(out, "needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
+}
+#endif
+
+static void report_heap(FILE *out, const char *name, uint32_t caps) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    fprintf(out, "%-9s %8u free %8u min free %8u largest\n", name, (unsigned)info.total_free_bytes,
+            (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block);
+}
+
+void hal_report_memory(FILE *out) {
+    report_heap(out, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    report_heap(out, "dma", MALLOC_CAP_DMA);
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    lv_mem_monitor_t mon;
+    bsp_display_lock(0);
+    lv_mem_monitor(&mon);
+    bsp_display_unlock();
+    fprintf(out, "%-9s %8u free %8u max used %3u%% frag\n", "lvgl", (unsigned)mon.free_size,
+            (unsigned)mon.max_used, (unsigned)mon.frag_pct);
+#else
+    fprintf(out, "%-9s allocates from the heap above\n", "lvgl");
+#endif
+}
+
+#if CONFIG_TEA_STATIC_ALLOC
+static bool storage_open(void);
+
+static atomic_bool s_heap_frozen;
+
+/* Task whose allocations are let through while frozen, during a settings
+ * write (hal_storage_save()); NULL otherwise */
+static _Atomic(TaskHandle_t) s_heap_exempt_task;
+
+/**
+ * Heap hook (CONFIG_HEAP_USE_HOOKS), called after every allocation. Runs
+ * in whatever context allocated, possibly with the cache disabled. An
+ * interrupt is never exempt, whichever task it interrupted.
+ */
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    (void)ptr;
+    if (!atomic_load_explicit(&s_heap_frozen, memory_order_relaxed)) {
+        return;
+    }
+    if (!xPortInIsrContext() &&
+        xTaskGetCurrentTaskHandle() == atomic_load_explicit(&s_heap_exempt_task, memory_order_relaxed)) {
+        return;
+    }
+    esp_rom_printf("Heap allocation after boot: %u bytes, caps 0x%x\n", (unsigned)size, (unsigned)caps);
+    abort();
+}
+#endif
+
+void hal_heap_freeze(void) {
+#if CONFIG_TEA_STATIC_ALLOC
+    /* The buzzer would allocate on the first alarm, NVS when opened */
+    buzzer_prepare();
+    storage_open();
+#endif
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_LOGI(TAG, "Heap after boot: %u bytes allocated, %u free, largest block %u",
+             (unsigned)info.total_allocated_bytes, (unsigned)info.total_free_bytes,
+             (unsigned)info.largest_free_block);
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    lv_mem_monitor_t mon;
+    bsp_display_lock(0);
+    lv_mem_monitor(&mon);
+    bsp_display_unlock();
+    ESP_LOGI(TAG, "LVGL pool after boot: %u of %u bytes used, %u at most",
+             (unsigned)(mon.total_size - mon.free_size), (unsigned)mon.total_size, (unsigned)mon.max_used);
+#endif
+
+#if CONFIG_TEA_STATIC_ALLOC
+    atomic_store_explicit(&s_heap_frozen, true, memory_order_relaxed);
+    ESP_LOGI(TAG, "Heap frozen, further allocations abort");
+#endif
+}
+
+/* Settings record in NVS, opened on first use */
+#define STORAGE_NAMESPACE  "tea_timer"
+#define STORAGE_KEY        "settings"
+static nvs_handle_t s_storage = 0;
+static bool s_storage_open = false;
+
+/**
+ * Initialize the NVS partition and open the namespace. A partition that is
+ * full or from a newer NVS version is erased, losing only the settings.
+ */
+static bool storage_open(void) {
+    if (s_storage_open) {
+        return true;
+    }
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition unusable (%s), erasing", esp_err_to_name(err));
+        err = nvs_flash_erase();
+        if (err == ESP_OK) {
+            err = nvs_flash_init();
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &s_storage);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    s_storage_open = true;
+    return true;
+}
+
+bool hal_storage_load(void *data, size_t size) {
+    if (!storage_open()) {
+        return false;
+    }
+    size_t stored = size;
+    esp_err_t err = nvs_get_blob(s_storage, STORAGE_KEY, data, &stored);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Reading settings failed: %s", esp_err_to_name(err));
+    }
+    return err == ESP_OK && stored == size;
+}
+
+bool hal_storage_save(const void *data, size_t size) {
+    if (!storage_open()) {
+        return false;
+    }
+#if CONFIG_TEA_STATIC_ALLOC
+    /* nvs_set_blob() allocates: a list node per blob chunk, freed before
+     * it returns, and an index block when the page's entry index fills.
+     * Writes are rare and come from the main loop only, so its allocations,
+     * and only its, are let through meanwhile. */
+    atomic_store_explicit(&s_heap_exempt_task, xTaskGetCurrentTaskHandle(), memory_order_relaxed);
+#endif
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = nvs_set_blob(s_storage, STORAGE_KEY, data, size);
+    if (err == ESP_OK) {
+        err = nvs_commit(s_storage);
+    }
+#if CONFIG_TEA_STATIC_ALLOC
+    atomic_store_explicit(&s_heap_exempt_task, NULL, memory_order_relaxed);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Writing settings failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TAG, "Settings written in %" PRId64 " us", esp_timer_get_time() - start_us);
+    return true;
+}
@@ -0,0 +1,201 @@
+#include "latency.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+/*
+ * Log-linear buckets: values below 8 us get one bucket each, above that
+ * every power of two is split into 4 buckets. Values from 2^24 us (16 s) up
+ * share the last bucket.
+ */
+#define EXACT_BUCKETS   8
+#define SUB_BUCKETS     4
+#define MAX_EXPONENT    24
+#define BUCKET_COUNT    (EXACT_BUCKETS + (MAX_EXPONENT - 3) * SUB_BUCKETS)
+
+typedef struct {
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t count;
+    uint32_t max_us;
+} histogram_t;
+
+static histogram_t s_histograms[LATENCY_STAGE_COUNT];
+
+/* Input waiting for its frame; only touched with the display lock held */
+static latency_marks_t s_pending;
+static bool s_pending_valid = false;
+static bool s_in_flight = false;
+
+/* Flushes handed to the driver (display lock) and completed (ISR). Both
+ * count up freely, so done - target is meaningful across wrap-around. */
+static uint32_t s_flushes_started = 0;
+static atomic_uint_fast32_t s_flushes_done;
+
+/* Rendered input waiting for flush number s_wait_target to complete. The
+ * fields are written before s_waiting is released, and the ISR takes the
+ * sample by clearing s_waiting, so each sample is recorded once. */
+static uint32_t s_wait_posted_us;
+static uint32_t s_wait_ready_us;
+static uint32_t s_wait_target;
+static atomic_bool s_waiting;
+
+static const char *const s_stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_STAGE_QUEUE]   = "queue",
+    [LATENCY_STAGE_LOGIC]   = "logic",
+    [LATENCY_STAGE_MAILBOX] = "mailbox",
+    [LATENCY_STAGE_VIEW]    = "view",
+    [LATENCY_STAGE_RENDER]  = "render",
+    [LATENCY_STAGE_FLUSH]   = "flush",
+    [LATENCY_STAGE_TOTAL]   = "total",
+    [LATENCY_STAGE_ALARM]   = "alarm",
+};
+
+static unsigned bucket_of(uint32_t us) {
+    if (us < EXACT_BUCKETS) {
+        return us;
+    }
+    unsigned exponent = 31 - (unsigned)__builtin_clz(us);  /* >= 3 */
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    unsigned sub = (us >> (exponent - 2)) & (SUB_BUCKETS - 1);
+    return EXACT_BUCKETS + (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+/**
+ * Largest value that falls into a bucket
+ */
+static uint32_t bucket_upper(unsigned bucket) {
+    if (bucket < EXACT_BUCKETS) {
+        return bucket;
+    }
+    unsigned exponent = (bucket - EXACT_BUCKETS) / SUB_BUCKETS + 3;
+    unsigned sub = (bucket - EXACT_BUCKETS) % SUB_BUCKETS;
+    return ((uint32_t)(SUB_BUCKETS + sub + 1) << (exponent - 2)) - 1;
+}
+
+static void record(latency_stage_t stage, uint32_t us) {
+    histogram_t *h = &s_histograms[stage];
+    h->buckets[bucket_of(us)]++;
+    h->count++;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+}
+
+void latency_reset(void) {
+    atomic_store(&s_waiting, false);
+    memset(s_histograms, 0, sizeof(s_histograms));
+    s_pending_valid = false;
+    s_in_flight = false;
+}
+
+void latency_frame_pending(const latency_marks_t *marks) {
+    record(LATENCY_STAGE_QUEUE, marks->dequeued_us - marks->posted_us);
+    record(LATENCY_STAGE_LOGIC, marks->logic_us - marks->dequeued_us);
+    record(LATENCY_STAGE_MAILBOX, marks->drained_us - marks->logic_us);
+    record(LATENCY_STAGE_VIEW, marks->viewed_us - marks->drained_us);
+    if (!s_pending_valid) {
+        s_pending = *marks;
+        s_pending_valid = true;
+        s_in_flight = false;
+    }
+}
+
+void latency_frame_start(uint32_t now_us) {
+    if (!s_pending_valid || s_in_flight) {
+        return;
+    }
+    if (now_us - s_pending.viewed_us > LATENCY_STALE_US) {
+        s_pending_valid = false;
+        return;
+    }
+    s_in_flight = true;
+}
+
+void latency_flush_start(void) {
+    s_flushes_started++;
+}
+
+/**
+ * Record the last two stages of the waiting sample, if flush number target
+ * has completed. Whoever clears s_waiting owns the sample.
+ */
+static void complete_if_flushed(uint32_t now_us) {
+    uint32_t done = (uint32_t)atomic_load(&s_flushes_done);
+    if ((int32_t)(done - s_wait_target) < 0) {
+        return;
+    }
+    bool expected = true;
+    if (atomic_compare_exchange_strong_explicit(&s_waiting, &expected, false,
+                                                memory_order_acquire, memory_order_relaxed)) {
+        record(LATENCY_STAGE_FLUSH, now_us - s_wait_ready_us);
+        record(LATENCY_STAGE_TOTAL, now_us - s_wait_posted_us);
+    }
+}
+
+void latency_frame_ready(uint32_t now_us) {
+    if (!s_in_flight) {
+        return;
+    }
+    record(LATENCY_STAGE_RENDER, now_us - s_pending.viewed_us);
+    s_pending_valid = false;
+    s_in_flight = false;
+
+    /* The previous sample's flushes finished before this frame's first one
+     * started, so it has been taken by now */
+    s_wait_posted_us = s_pending.posted_us;
+    s_wait_ready_us = now_us;
+    s_wait_target = s_flushes_started;
+    atomic_store(&s_waiting, true);
+
+    /* The last transfer may already be done, or the frame drew nothing */
+    complete_if_flushed(now_us);
+}
+
+void latency_flush_done(uint32_t now_us) {
+    /* Sequentially consistent against latency_frame_ready(): one of the
+     * two sees both the flag and the count */
+    atomic_fetch_add(&s_flushes_done, 1);
+    if (atomic_load(&s_waiting)) {
+        complete_if_flushed(now_us);
+    }
+}
+
+void latency_alarm_stopped(uint32_t posted_us, uint32_t now_us) {
+    record(LATENCY_STAGE_ALARM, now_us - posted_us);
+}
+
+void latency_get(latency_stage_t stage, latency_summary_t *summary) {
+    const histogram_t *h = &s_histograms[stage];
+    *summary = (latency_summary_t){ .count = h->count, .max_us = h->max_us };
+    if (h->count == 0) {
+        return;
+    }
+
+    /* Ranks of the percentiles, rounded up */
+    uint32_t rank50 = (h->count + 1) / 2;
+    uint32_t rank99 = (uint32_t)(((uint64_t)h->count * 99 + 99) / 100);
+    uint32_t seen = 0;
+    bool have_p50 = false;
+    for (unsigned b = 0; b < BUCKET_COUNT; b++) {
+        if (h->buckets[b] == 0) {
+            continue;
+        }
+        seen += h->buckets[b];
+        uint32_t upper = bucket_upper(b) < h->max_us ? bucket_upper(b) : h->max_us;
+        /* A p50 of 0 us is a valid result, not "not found yet" */
+        if (!have_p50 && seen >= rank50) {
+            summary->p50_us = upper;
+            have_p50 = true;
+        }
+        if (seen >= rank99) {
+            summary->p99_us = upper;
+            break;
+        }
+    }
+}
+
+const char *latency_stage_name(latency_stage_t stage) {
+    return (unsigned)stage < LATENCY_STAGE_COUNT ? s_stage_names[stage] : "?";
+}
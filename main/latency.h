@@ -0,0 +1,121 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Input-to-photon latency.
+ *
+ * A button click or encoder detent is timestamped when it is posted, and
+ * again as the main loop takes it and after the logic. The loop posts the
+ * marks with the new view model (view_post()); the renderer stamps them when
+ * it takes the model from the mailbox and after view_update(). The marks are
+ * then parked until the display refresh that draws the change: the next
+ * LV_EVENT_REFR_START picks them up and LV_EVENT_REFR_READY notes how many
+ * flushes the frame started. The sample completes in the panel IO's transfer-done callback for the last of
+ * those flushes, when the pixels have left for the panel. Every stage goes
+ * into its own histogram, read back with latency_get() at runtime.
+ *
+ * Timestamps are the low 32 bits of hal_mono_us(), or of esp_timer_get_time()
+ * in the display callbacks, which is the same clock on the device. The
+ * console's fast-forward does not move it. Stages are differences, so the
+ * wrap every 71 minutes is harmless.
+ */
+
+/**
+ * Pipeline stages, each measured from the end of the previous one
+ */
+typedef enum {
+    LATENCY_STAGE_QUEUE,    /* Posted -> taken by the main loop */
+    LATENCY_STAGE_LOGIC,    /* -> logic_process_event() done */
+    LATENCY_STAGE_MAILBOX,  /* -> view model taken from the mailbox */
+    LATENCY_STAGE_VIEW,     /* -> view_update() done */
+    LATENCY_STAGE_RENDER,   /* -> LVGL refresh drawing it is ready */
+    LATENCY_STAGE_FLUSH,    /* -> last SPI transfer of that frame done */
+    LATENCY_STAGE_TOTAL,    /* Posted -> last transfer done */
+    LATENCY_STAGE_ALARM,    /* Not a stage: input posted -> alarm silenced */
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+/**
+ * Timestamps of one input on its way to the panel
+ */
+typedef struct {
+    uint32_t posted_us;
+    uint32_t dequeued_us;
+    uint32_t logic_us;
+    uint32_t drained_us;
+    uint32_t viewed_us;
+} latency_marks_t;
+
+/**
+ * Histogram summary. Percentiles are bucket upper bounds, within 25% of
+ * the true value; max is exact.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} latency_summary_t;
+
+/* Pending marks older than this when a refresh starts are dropped: the
+ * change did not invalidate anything, so no frame was drawn for it */
+#define LATENCY_STALE_US  (100 * 1000)
+
+/**
+ * Clear all histograms and any pending input
+ */
+void latency_reset(void);
+
+/**
+ * Record the loop and mailbox stages of an input whose change is now in the
+ * view, and hold it for the refresh. If an earlier input is still waiting for its
+ * frame, that one is kept: it is the one the user has waited longest for.
+ * Call with the display lock held.
+ */
+void latency_frame_pending(const latency_marks_t *marks);
+
+/**
+ * LV_EVENT_REFR_START: the refresh will draw the pending input, if any.
+ * Display lock held (LVGL task or hal_display_refresh_now()).
+ */
+void latency_frame_start(uint32_t now_us);
+
+/**
+ * LV_EVENT_FLUSH_START: one more area handed to the panel driver.
+ * Display lock held.
+ */
+void latency_flush_start(void);
+
+/**
+ * LV_EVENT_REFR_READY: the input drawn by this refresh now waits for the
+ * frame's last flush. Display lock held.
+ */
+void latency_frame_ready(uint32_t now_us);
+
+/**
+ * Panel IO transfer-done callback, one per flush. ISR safe.
+ */
+void latency_flush_done(uint32_t now_us);
+
+/**
+ * The input posted at posted_us stopped the alarm. This path does not wait
+ * for the display, so it shows how long the loop task waited for the CPU,
+ * e.g. behind a full-screen redraw of the alarm flash. Main loop only.
+ */
+void latency_alarm_stopped(uint32_t posted_us, uint32_t now_us);
+
+/**
+ * Summary of one stage. Safe from any task; counts updated concurrently
+ * may be off by one.
+ */
+void latency_get(latency_stage_t stage, latency_summary_t *summary);
+
+/**
+ * Short name of a stage, for logs
+ */
+const char *latency_stage_name(latency_stage_t stage);
+
+#endif /* LATENCY_H */
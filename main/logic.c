@@ -1,11 +1,128 @@
+#include <stddef.h>
+
 #include "logic.h"
 
 void logic_init(app_state_t *state) {
     state->state = STATE_SETUP;
     state->target_time_secs = 300;  /* Default 5 minutes */
     state->remaining_time_secs = 300;
+    state->deadline_us = 0;
     state->last_encoder_count = 0;
     state->alarm_flash_on = false;
+    state->timer_count = 0;
+}
+
+/**
+ * Whole seconds left until deadline_us, rounded up so that zero means the
+ * deadline has been reached
+ */
+static uint32_t remaining_secs(int64_t deadline_us, int64_t now_us) {
+    if (now_us >= deadline_us) {
+        return 0;
+    }
+    return (uint32_t)((deadline_us - now_us + LOGIC_US_PER_SEC - 1) / LOGIC_US_PER_SEC);
+}
+
+/**
+ * Add a brew to the deadline heap (sift up)
+ */
+static void timer_push(app_state_t *state, logic_timer_t timer) {
+    size_t i = state->timer_count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (state->timers[parent].deadline_us <= timer.deadline_us) {
+            break;
+        }
+        state->timers[i] = state->timers[parent];
+        i = parent;
+    }
+    state->timers[i] = timer;
+}
+
+/**
+ * Remove the soonest brew from the deadline heap (sift down)
+ */
+static void timer_pop(app_state_t *state) {
+    logic_timer_t last = state->timers[--state->timer_count];
+    size_t n = state->timer_count;
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && state->timers[child + 1].deadline_us < state->timers[child].deadline_us) {
+            child++;
+        }
+        if (last.deadline_us <= state->timers[child].deadline_us) {
+            break;
+        }
+        state->timers[i] = state->timers[child];
+        i = child;
+    }
+    if (n > 0) {
+        state->timers[i] = last;
+    }
+}
+
+/**
+ * Follow the soonest brew after the heap changed: point deadline_us at it
+ * and show its remaining time
+ */
+static void show_soonest(app_state_t *state, int64_t now_us) {
+    if (state->timer_count > 0) {
+        state->deadline_us = state->timers[0].deadline_us;
+        state->remaining_time_secs = remaining_secs(state->deadline_us, now_us);
+    } else {
+        state->remaining_time_secs = state->target_time_secs;
+    }
+}
+
+/**
+ * Remove every brew whose deadline has passed
+ *
+ * @return Number of brews that ended
+ */
+static uint32_t pop_expired(app_state_t *state, int64_t now_us) {
+    uint32_t expired = 0;
+    while (state->timer_count > 0 && state->timers[0].deadline_us <= now_us) {
+        timer_pop(state);
+        expired++;
+    }
+    if (state->timer_count > 0) {
+        state->deadline_us = state->timers[0].deadline_us;
+    }
+    return expired;
+}
+
+/**
+ * Tick handling shared by every state with brews running. Ended brews raise
+ * the alarm (once), and the tick is re-aimed at the next brew or stopped.
+ */
+static uint32_t handle_tick(app_state_t *state, int64_t now_us) {
+    uint32_t actions = ACTION_NONE;
+
+    if (pop_expired(state, now_us) > 0) {
+        if (state->state != STATE_ALARM) {
+            /* Brew complete - go to alarm */
+            state->state = STATE_ALARM;
+            state->alarm_flash_on = true;
+            state->remaining_time_secs = 0;
+            actions |= ACTION_UPDATE_UI | ACTION_ALARM_START;
+        }
+        actions |= (state->timer_count > 0) ? ACTION_START_TIMER : ACTION_STOP_TIMER;
+        return actions;
+    }
+
+    if (state->state == STATE_RUNNING && state->timer_count > 0) {
+        /* Derive from the clock rather than counting ticks */
+        uint32_t remaining = remaining_secs(state->deadline_us, now_us);
+        if (remaining != state->remaining_time_secs) {
+            state->remaining_time_secs = remaining;
+            actions = ACTION_UPDATE_UI;
+        }
+    }
+    return actions;
 }
 
 /**
@@ -39,165 +156,278 @@ static uint32_t handle_encoder_setup(app_state_t *state, int32_t new_count) {
     return ACTION_UPDATE_UI;
 }
 
-/**
- * Process events in SETUP state
+/*
+ * Transition handlers. A handler runs before the table entry is applied and
+ * returns actions to add to the entry's own. It returns LOGIC_REJECT
+ * (possibly with actions) when a guard fails: the entry's next state and
+ * actions are then skipped. Entries whose next state depends on the running
+ * brews use LOGIC_STAY and let the handler set it.
  */
-static uint32_t process_setup(app_state_t *state, logic_event_t event, int32_t value) {
-    uint32_t actions = ACTION_NONE;
+#define LOGIC_STAY    STATE_COUNT
+#define LOGIC_REJECT  (1u << 31)
 
-    switch (event) {
-        case EVT_BUTTON_PRESS:
-            /* Start the timer */
-            state->state = STATE_RUNNING;
-            state->remaining_time_secs = state->target_time_secs;
-            actions = ACTION_UPDATE_UI | ACTION_START_TIMER;
-            break;
+typedef uint32_t (*logic_handler_t)(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us);
 
-        case EVT_ENCODER_CHANGE:
-            actions = handle_encoder_setup(state, value);
-            break;
+/**
+ * Countdown tick in any state with brews running
+ */
+static uint32_t on_tick(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)value;
+    return handle_tick(state, now_us);
+}
 
-        case EVT_INACTIVITY_TIMEOUT:
-            /* Go to sleep */
-            state->state = STATE_SLEEP;
-            actions = ACTION_UPDATE_UI | ACTION_BACKLIGHT_OFF;
-            break;
+/**
+ * Encoder in SETUP: adjust the dialled time
+ */
+static uint32_t on_dial(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)now_us;
+    return handle_encoder_setup(state, value);
+}
 
-        default:
-            break;
+/**
+ * Click in SETUP: start a brew; the tick follows whichever brew ends first
+ */
+static uint32_t on_start_brew(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)value;
+    if (state->timer_count >= LOGIC_MAX_TIMERS) {
+        return LOGIC_REJECT;
     }
-
-    return actions;
+    timer_push(state, (logic_timer_t){
+        .deadline_us = now_us + (int64_t)state->target_time_secs * LOGIC_US_PER_SEC,
+        .duration_secs = state->target_time_secs,
+    });
+    show_soonest(state, now_us);
+    return ACTION_NONE;
 }
 
 /**
- * Process events in RUNNING state
+ * Inactivity in SETUP: back to the countdown if brews are running (an
+ * abandoned dial-in), otherwise go to sleep
  */
-static uint32_t process_running(app_state_t *state, logic_event_t event, int32_t value) {
-    uint32_t actions = ACTION_NONE;
-    (void)value;  /* Unused in RUNNING state */
-
-    switch (event) {
-        case EVT_BUTTON_PRESS:
-            /* Cancel timer, return to setup */
-            state->state = STATE_SETUP;
-            state->remaining_time_secs = state->target_time_secs;
-            actions = ACTION_UPDATE_UI | ACTION_STOP_TIMER;
-            break;
-
-        case EVT_TICK_1HZ:
-            if (state->remaining_time_secs > 0) {
-                state->remaining_time_secs--;
-                actions = ACTION_UPDATE_UI;
-
-                if (state->remaining_time_secs == 0) {
-                    /* Timer complete - go to alarm */
-                    state->state = STATE_ALARM;
-                    state->alarm_flash_on = true;
-                    actions |= ACTION_STOP_TIMER | ACTION_ALARM_START;
-                }
-            }
-            break;
-
-        case EVT_ENCODER_CHANGE:
-            /* Encoder ignored in RUNNING state */
-            /* But update last_encoder_count to avoid jump when returning to SETUP */
-            state->last_encoder_count = value;
-            break;
-
-        default:
-            break;
+static uint32_t on_setup_timeout(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)value;
+    if (state->timer_count > 0) {
+        state->state = STATE_RUNNING;
+        show_soonest(state, now_us);
+        return ACTION_UPDATE_UI;
     }
-
-    return actions;
+    state->state = STATE_SLEEP;
+    return ACTION_UPDATE_UI | ACTION_BACKLIGHT_OFF | ACTION_SLEEP;
 }
 
 /**
- * Process events in ALARM state
+ * Click in RUNNING: cancel the soonest brew, return to setup if it was the last
  */
-static uint32_t process_alarm(app_state_t *state, logic_event_t event, int32_t value) {
-    uint32_t actions = ACTION_NONE;
-
-    switch (event) {
-        case EVT_BUTTON_PRESS:
-        case EVT_ENCODER_CHANGE:
-            /* Any input stops the alarm */
-            state->state = STATE_SETUP;
-            state->remaining_time_secs = state->target_time_secs;
-            state->alarm_flash_on = false;
-            state->last_encoder_count = value;
-            /* Explicitly turn backlight on - buzzer LEDC can interfere */
-            actions = ACTION_UPDATE_UI | ACTION_ALARM_STOP | ACTION_BACKLIGHT_ON;
-            break;
+static uint32_t on_cancel_brew(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)value;
+    timer_pop(state);
+    if (state->timer_count > 0) {
+        show_soonest(state, now_us);
+        return ACTION_START_TIMER;
+    }
+    state->state = STATE_SETUP;
+    state->remaining_time_secs = state->target_time_secs;
+    return ACTION_STOP_TIMER;
+}
 
-        case EVT_TICK_FAST:
-            /* Toggle flash state */
-            state->alarm_flash_on = !state->alarm_flash_on;
-            actions = ACTION_TOGGLE_FLASH;
-            break;
+/**
+ * Encoder in RUNNING: dial in another brew while this one keeps running
+ */
+static uint32_t on_dial_another(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)now_us;
+    if (state->timer_count >= LOGIC_MAX_TIMERS) {
+        /* No room for another brew: encoder ignored, but update
+         * last_encoder_count to avoid a jump when returning to SETUP */
+        state->last_encoder_count = value;
+        return LOGIC_REJECT;
+    }
+    uint32_t actions = handle_encoder_setup(state, value);
+    return (actions != ACTION_NONE) ? actions : LOGIC_REJECT;
+}
 
-        default:
-            break;
+/**
+ * Any input in ALARM: stop the alarm, back to the next brew if any
+ */
+static uint32_t on_dismiss_alarm(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    state->state = (state->timer_count > 0) ? STATE_RUNNING : STATE_SETUP;
+    show_soonest(state, now_us);
+    state->alarm_flash_on = false;
+    if (event == EVT_ENCODER_CHANGE) {
+        /* Button events carry no count; keep the baseline */
+        state->last_encoder_count = value;
     }
+    return ACTION_NONE;
+}
 
-    return actions;
+/**
+ * Fast tick in ALARM: toggle flash state
+ */
+static uint32_t on_flash(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)value;
+    (void)now_us;
+    state->alarm_flash_on = !state->alarm_flash_on;
+    return ACTION_NONE;
 }
 
 /**
- * Process events in SLEEP state
+ * Encoder in SLEEP: take the count as the new baseline
  */
-static uint32_t process_sleep(app_state_t *state, logic_event_t event, int32_t value) {
-    uint32_t actions = ACTION_NONE;
+static uint32_t on_wake_encoder(app_state_t *state, logic_event_t event, int32_t value, int64_t now_us) {
+    (void)event;
+    (void)now_us;
+    state->last_encoder_count = value;
+    return ACTION_NONE;
+}
 
-    switch (event) {
-        case EVT_BUTTON_PRESS:
-        case EVT_ENCODER_CHANGE:
-            /* Any input wakes up */
-            state->state = STATE_SETUP;
-            state->last_encoder_count = value;
-            actions = ACTION_UPDATE_UI | ACTION_BACKLIGHT_ON;
-            break;
+/**
+ * Transition table: T(state, event, next state, actions, handler).
+ * Every state x event pair must appear exactly once; this is checked at
+ * compile time below.
+ *
+ * Explicitly turn the backlight on when leaving ALARM - the buzzer LEDC can
+ * interfere with it. In SLEEP, a second inactivity timeout (a wake without
+ * a usable input, e.g. a press that was not a click) goes back to sleep.
+ */
+#define LOGIC_TRANSITIONS(T) \
+    T(SETUP,   NONE,               LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SETUP,   BUTTON_PRESS,       STATE_RUNNING, ACTION_UPDATE_UI | ACTION_START_TIMER,          on_start_brew)    \
+    T(SETUP,   ENCODER_CHANGE,     LOGIC_STAY,    ACTION_NONE,                                    on_dial)          \
+    T(SETUP,   TICK_1HZ,           LOGIC_STAY,    ACTION_NONE,                                    on_tick)          \
+    T(SETUP,   TICK_FAST,          LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SETUP,   INACTIVITY_TIMEOUT, LOGIC_STAY,    ACTION_NONE,                                    on_setup_timeout) \
+    T(RUNNING, NONE,               LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(RUNNING, BUTTON_PRESS,       LOGIC_STAY,    ACTION_UPDATE_UI,                               on_cancel_brew)   \
+    T(RUNNING, ENCODER_CHANGE,     STATE_SETUP,   ACTION_NONE,                                    on_dial_another)  \
+    T(RUNNING, TICK_1HZ,           LOGIC_STAY,    ACTION_NONE,                                    on_tick)          \
+    T(RUNNING, TICK_FAST,          LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(RUNNING, INACTIVITY_TIMEOUT, LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(ALARM,   NONE,               LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(ALARM,   BUTTON_PRESS,       LOGIC_STAY,    ACTION_UPDATE_UI | ACTION_ALARM_STOP | ACTION_BACKLIGHT_ON, on_dismiss_alarm) \
+    T(ALARM,   ENCODER_CHANGE,     LOGIC_STAY,    ACTION_UPDATE_UI | ACTION_ALARM_STOP | ACTION_BACKLIGHT_ON, on_dismiss_alarm) \
+    T(ALARM,   TICK_1HZ,           LOGIC_STAY,    ACTION_NONE,                                    on_tick)          \
+    T(ALARM,   TICK_FAST,          LOGIC_STAY,    ACTION_TOGGLE_FLASH,                            on_flash)         \
+    T(ALARM,   INACTIVITY_TIMEOUT, LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SLEEP,   NONE,               LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SLEEP,   BUTTON_PRESS,       STATE_SETUP,   ACTION_UPDATE_UI | ACTION_BACKLIGHT_ON,         NULL)             \
+    T(SLEEP,   ENCODER_CHANGE,     STATE_SETUP,   ACTION_UPDATE_UI | ACTION_BACKLIGHT_ON,         on_wake_encoder)  \
+    T(SLEEP,   TICK_1HZ,           LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SLEEP,   TICK_FAST,          LOGIC_STAY,    ACTION_NONE,                                    NULL)             \
+    T(SLEEP,   INACTIVITY_TIMEOUT, LOGIC_STAY,    ACTION_SLEEP,                                   NULL)
+
+/* Coverage check: one enumerator per entry, so a duplicate pair fails to
+ * compile and a missing one fails the count */
+enum {
+#define LOGIC_T_CHECK(st, ev, next, actions, handler) LOGIC_T_##st##_##ev,
+    LOGIC_TRANSITIONS(LOGIC_T_CHECK)
+#undef LOGIC_T_CHECK
+    LOGIC_T_COUNT
+};
+_Static_assert(LOGIC_T_COUNT == STATE_COUNT * EVT_COUNT,
+               "LOGIC_TRANSITIONS must cover every state x event pair exactly once");
+
+typedef struct {
+    logic_handler_t handler;  /* NULL if the entry needs no code */
+    uint16_t actions;         /* logic_action_t bits emitted when taken */
+    uint8_t next_state;       /* tea_state_t, or LOGIC_STAY */
+} logic_transition_t;
+
+static const logic_transition_t s_transitions[STATE_COUNT][EVT_COUNT] = {
+#define LOGIC_T_ENTRY(st, ev, next, act, fn) \
+    [STATE_##st][EVT_##ev] = { .handler = fn, .actions = (act), .next_state = (next) },
+    LOGIC_TRANSITIONS(LOGIC_T_ENTRY)
+#undef LOGIC_T_ENTRY
+};
+
+#if LOGIC_TRANSITION_COUNTERS
+static uint32_t s_transition_counts[STATE_COUNT][EVT_COUNT];
+#endif
+
+uint32_t logic_process_event(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us) {
+    if ((unsigned)state->state >= STATE_COUNT || (unsigned)event >= EVT_COUNT) {
+        return ACTION_NONE;
+    }
+#if LOGIC_TRANSITION_COUNTERS
+    s_transition_counts[state->state][event]++;
+#endif
+
+    const logic_transition_t *t = &s_transitions[state->state][event];
+    uint32_t result = (t->handler != NULL) ? t->handler(state, event, event_value, now_us) : ACTION_NONE;
+    if (result & LOGIC_REJECT) {
+        return result & ~LOGIC_REJECT;
+    }
+    if (t->next_state != LOGIC_STAY) {
+        state->state = (tea_state_t)t->next_state;
+    }
+    return t->actions | result;
+}
 
-        default:
-            break;
+uint32_t logic_transition_count(tea_state_t state, logic_event_t event) {
+#if LOGIC_TRANSITION_COUNTERS
+    if ((unsigned)state < STATE_COUNT && (unsigned)event < EVT_COUNT) {
+        return s_transition_counts[state][event];
     }
+#else
+    (void)state;
+    (void)event;
+#endif
+    return 0;
+}
 
-    return actions;
+int64_t logic_tick_delay_us(int64_t deadline_us, int64_t now_us, bool tenths) {
+    if (now_us >= deadline_us) {
+        return 0;
+    }
+    int64_t left = deadline_us - now_us;
+    int64_t step = (tenths && left <= (int64_t)LOGIC_TENTHS_SECS * LOGIC_US_PER_SEC)
+                   ? LOGIC_US_PER_SEC / 10 : LOGIC_US_PER_SEC;
+    int64_t delay = left % step;
+    return (delay == 0) ? step : delay;
 }
 
-uint32_t logic_process_event(app_state_t *state, logic_event_t event, int32_t event_value) {
+uint8_t logic_get_progress(const app_state_t *state) {
+    if (state->target_time_secs == 0) {
+        return 100;
+    }
+
     switch (state->state) {
         case STATE_SETUP:
-            return process_setup(state, event, event_value);
+            /* In setup, show full arc */
+            return 100;
 
         case STATE_RUNNING:
-            return process_running(state, event, event_value);
+            /* Show remaining time of the soonest brew as percentage */
+            if (state->timer_count == 0 || state->timers[0].duration_secs == 0) {
+                return 100;
+            }
+            return (uint8_t)((state->remaining_time_secs * 100) / state->timers[0].duration_secs);
 
         case STATE_ALARM:
-            return process_alarm(state, event, event_value);
+            /* The brew that ended has no time left */
+            return 0;
 
         case STATE_SLEEP:
-            return process_sleep(state, event, event_value);
-
         default:
-            return ACTION_NONE;
+            return 0;
     }
 }
 
-uint8_t logic_get_progress(const app_state_t *state) {
-    if (state->target_time_secs == 0) {
-        return 100;
-    }
-
+uint8_t logic_get_other_timers(const app_state_t *state) {
     switch (state->state) {
-        case STATE_SETUP:
-            /* In setup, show full arc */
-            return 100;
-
         case STATE_RUNNING:
+            /* The soonest brew is the one on screen */
+            return (state->timer_count > 0) ? state->timer_count - 1 : 0;
+
+        case STATE_SETUP:
         case STATE_ALARM:
-            /* Show remaining time as percentage */
-            return (uint8_t)((state->remaining_time_secs * 100) / state->target_time_secs);
+            /* Showing the dial or the finished brew, all others are hidden */
+            return state->timer_count;
 
         case STATE_SLEEP:
         default:
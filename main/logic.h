@@ -11,7 +11,8 @@ typedef enum {
     STATE_SETUP,    /* Selecting time */
     STATE_RUNNING,  /* Countdown active */
     STATE_ALARM,    /* Timer complete */
-    STATE_SLEEP     /* Display off, low power */
+    STATE_SLEEP,    /* Display off, low power */
+    STATE_COUNT
 } tea_state_t;
 
 /**
@@ -23,7 +24,8 @@ typedef enum {
     EVT_ENCODER_CHANGE,
     EVT_TICK_1HZ,
     EVT_TICK_FAST,
-    EVT_INACTIVITY_TIMEOUT
+    EVT_INACTIVITY_TIMEOUT,
+    EVT_COUNT
 } logic_event_t;
 
 /**
@@ -32,24 +34,41 @@ typedef enum {
 typedef enum {
     ACTION_NONE           = 0,
     ACTION_UPDATE_UI      = (1 << 0),  /* Refresh the display */
-    ACTION_START_TIMER    = (1 << 1),  /* Start the 1Hz countdown timer */
-    ACTION_STOP_TIMER     = (1 << 2),  /* Stop the 1Hz countdown timer */
+    ACTION_START_TIMER    = (1 << 1),  /* (Re)start the countdown tick, aligned to deadline_us */
+    ACTION_STOP_TIMER     = (1 << 2),  /* Stop the countdown tick, no brews left */
     ACTION_ALARM_START    = (1 << 3),  /* Start alarm: buzzer (if enabled) and flashing */
     ACTION_ALARM_STOP     = (1 << 4),  /* Stop alarm: buzzer and flashing */
     ACTION_BACKLIGHT_ON   = (1 << 5),  /* Turn display backlight on */
     ACTION_BACKLIGHT_OFF  = (1 << 6),  /* Turn display backlight off */
-    ACTION_TOGGLE_FLASH   = (1 << 7)   /* Toggle alarm flash state */
+    ACTION_TOGGLE_FLASH   = (1 << 7),  /* Toggle alarm flash state */
+    ACTION_SLEEP          = (1 << 8)   /* Enter low-power sleep until the next input */
 } logic_action_t;
 
+/**
+ * Maximum number of brews running at once
+ */
+#define LOGIC_MAX_TIMERS 4
+
+/**
+ * One running brew
+ */
+typedef struct {
+    int64_t deadline_us;          /* Monotonic time the brew ends */
+    uint32_t duration_secs;       /* Brew length, for progress */
+} logic_timer_t;
+
 /**
  * Application state structure
  */
 typedef struct {
     tea_state_t state;
     uint32_t target_time_secs;    /* User-selected time (seconds) */
-    uint32_t remaining_time_secs; /* Countdown remaining (seconds) */
+    uint32_t remaining_time_secs; /* Displayed countdown (seconds) of the soonest brew */
+    int64_t deadline_us;          /* Deadline of the soonest brew, when timer_count > 0 */
     int32_t last_encoder_count;   /* For delta calculation */
     bool alarm_flash_on;          /* Toggle state for alarm flashing */
+    logic_timer_t timers[LOGIC_MAX_TIMERS];  /* Running brews, min-heap on deadline_us */
+    uint8_t timer_count;
 } app_state_t;
 
 /**
@@ -59,6 +78,8 @@ typedef struct {
 #define LOGIC_MAX_TIME_SECS   600  /* 10 minutes maximum */
 #define LOGIC_TIME_STEP_SECS  60   /* 1 minute increments */
 #define LOGIC_ENCODER_DIVISOR 4    /* 4 counts per detent */
+#define LOGIC_US_PER_SEC      1000000
+#define LOGIC_TENTHS_SECS     10   /* Tenths are shown for the last 10 seconds, if enabled */
 
 /**
  * Initialize the application state.
@@ -71,12 +92,53 @@ void logic_init(app_state_t *state);
  * Process an event and update state.
  * This is a pure function with no side effects on hardware.
  *
+ * Each brew is held as an absolute deadline, and the remaining time is
+ * recomputed from now_us on every tick. A late or lost tick therefore only
+ * delays a display update, never the end of a brew.
+ *
+ * Several brews can run at once. They are kept in a min-heap on their
+ * deadlines, so only the soonest one drives the tick (deadline_us) and
+ * adding or removing a brew costs O(log LOGIC_MAX_TIMERS). Turning the
+ * encoder while brewing dials in another brew; a click starts it.
+ *
+ * Dispatch is a lookup in a constant state x event transition table (see
+ * LOGIC_TRANSITIONS in logic.c), which is checked at compile time to cover
+ * every pair.
+ *
  * @param state        Pointer to current state (will be modified)
  * @param event        The event to process
  * @param event_value  Value associated with event (e.g., encoder count)
+ * @param now_us       Current monotonic time in microseconds
  * @return Bitmask of actions to perform (logic_action_t)
  */
-uint32_t logic_process_event(app_state_t *state, logic_event_t event, int32_t event_value);
+uint32_t logic_process_event(app_state_t *state, logic_event_t event, int32_t event_value, int64_t now_us);
+
+/**
+ * Build with LOGIC_TRANSITION_COUNTERS=1 to count how often each
+ * state x event transition is dispatched
+ */
+#ifndef LOGIC_TRANSITION_COUNTERS
+#define LOGIC_TRANSITION_COUNTERS 0
+#endif
+
+/**
+ * Number of times an event was dispatched in a state since boot.
+ *
+ * @return The count, or 0 if LOGIC_TRANSITION_COUNTERS is off
+ */
+uint32_t logic_transition_count(tea_state_t state, logic_event_t event);
+
+/**
+ * Delay until the displayed remaining time next changes, i.e. the next
+ * whole-second boundary before deadline_us, or with tenths the next tenth
+ * once no more than LOGIC_TENTHS_SECS remain. Used to (re)arm the tick.
+ *
+ * @param deadline_us  End of the countdown
+ * @param now_us       Current monotonic time
+ * @param tenths       Count down the last seconds in tenths
+ * @return Delay in microseconds (1..LOGIC_US_PER_SEC), or 0 if the deadline has passed
+ */
+int64_t logic_tick_delay_us(int64_t deadline_us, int64_t now_us, bool tenths);
 
 /**
  * Get progress percentage for UI arc display.
@@ -86,4 +148,13 @@ uint32_t logic_process_event(app_state_t *state, logic_event_t event, int32_t ev
  */
 uint8_t logic_get_progress(const app_state_t *state);
 
+/**
+ * Number of running brews not shown as the main countdown, for the UI
+ * indicator.
+ *
+ * @param state  Current application state
+ * @return Brews running in the background
+ */
+uint8_t logic_get_other_timers(const app_state_t *state);
+
 #endif /* LOGIC_H */
@@ -0,0 +1,143 @@
+#include <stddef.h>
+
+#include "melody.h"
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Alarm melody from the first version: played in sequence with no pauses */
+static const melody_note_t s_classic_notes[] = {
+    { 587, 326, 100 },  /* D5 quarter */
+    { 698, 489, 100 },  /* F5 dotted quarter */
+    { 784, 163, 100 },  /* G5 eighth */
+    { 659, 163, 100 },  /* E5 eighth */
+    { 523, 163, 100 },  /* C5 eighth */
+};
+
+/* Westminster quarters, first two changes */
+static const melody_note_t s_chime_notes[] = {
+    { 659, 400, 100 },  /* E5 */
+    { 523, 400, 90 },   /* C5 */
+    { 587, 400, 90 },   /* D5 */
+    { 392, 800, 100 },  /* G4 half */
+    { 392, 400, 100 },  /* G4 */
+    { 587, 400, 90 },   /* D5 */
+    { 659, 400, 90 },   /* E5 */
+    { 523, 800, 100 },  /* C5 half */
+};
+
+/* Four short beeps per burst */
+static const melody_note_t s_beeps_notes[] = {
+    { 2000, 90, 100 }, { MELODY_REST, 90, 0 },
+    { 2000, 90, 100 }, { MELODY_REST, 90, 0 },
+    { 2000, 90, 100 }, { MELODY_REST, 90, 0 },
+    { 2000, 90, 100 }, { MELODY_REST, 90, 0 },
+};
+
+static const melody_t s_melodies[MELODY_COUNT] = {
+    [MELODY_CLASSIC] = {
+        .name = "classic",
+        .notes = s_classic_notes,
+        .note_count = ARRAY_LEN(s_classic_notes),
+        .plays = 1,
+        .envelope = { .decay_ms = 0, .sustain_pct = 100 },
+    },
+    [MELODY_CHIME] = {
+        .name = "chime",
+        .notes = s_chime_notes,
+        .note_count = ARRAY_LEN(s_chime_notes),
+        .plays = 2,
+        .gap_ms = 600,
+        .envelope = { .decay_ms = 350, .sustain_pct = 20 },
+    },
+    [MELODY_BEEPS] = {
+        .name = "beeps",
+        .notes = s_beeps_notes,
+        .note_count = ARRAY_LEN(s_beeps_notes),
+        .plays = 3,
+        .gap_ms = 500,
+        .envelope = { .decay_ms = 0, .sustain_pct = 100 },
+    },
+};
+
+const melody_t *melody_get(melody_id_t id) {
+    if ((unsigned)id >= MELODY_COUNT) {
+        return NULL;
+    }
+    return &s_melodies[id];
+}
+
+static uint8_t melody_plays(const melody_t *melody) {
+    return melody->plays > 0 ? melody->plays : 1;
+}
+
+void melody_start(melody_cursor_t *cursor, const melody_t *melody) {
+    cursor->melody = melody;
+    cursor->note = 0;
+    cursor->play = 0;
+    cursor->gap_pending = false;
+    cursor->at_ms = 0;
+}
+
+/**
+ * Next note or gap straight from the table, without merging rests
+ */
+static bool raw_next(melody_cursor_t *cursor, melody_step_t *step) {
+    const melody_t *melody = cursor->melody;
+
+    if (cursor->gap_pending) {
+        cursor->gap_pending = false;
+        *step = (melody_step_t){ .duration_ms = melody->gap_ms, .freq_hz = MELODY_REST };
+    } else {
+        if (cursor->play >= melody_plays(melody) || melody->note_count == 0) {
+            return false;
+        }
+        const melody_note_t *note = &melody->notes[cursor->note];
+        *step = (melody_step_t){ .duration_ms = note->duration_ms, .freq_hz = note->freq_hz };
+        if (note->freq_hz != MELODY_REST) {
+            const melody_envelope_t *env = &melody->envelope;
+            step->peak_pct = note->volume_pct;
+            step->sustain_pct = note->volume_pct;
+            if (env->decay_ms > 0 && env->sustain_pct < 100) {
+                step->sustain_pct = (uint8_t)(note->volume_pct * env->sustain_pct / 100);
+                step->decay_ms = env->decay_ms < note->duration_ms ? env->decay_ms : note->duration_ms;
+            }
+        }
+
+        if (++cursor->note >= melody->note_count) {
+            cursor->note = 0;
+            cursor->play++;
+            cursor->gap_pending = cursor->play < melody_plays(melody) && melody->gap_ms > 0;
+        }
+    }
+
+    step->start_ms = cursor->at_ms;
+    cursor->at_ms += step->duration_ms;
+    return true;
+}
+
+bool melody_next(melody_cursor_t *cursor, melody_step_t *step) {
+    if (!raw_next(cursor, step)) {
+        return false;
+    }
+    if (step->freq_hz != MELODY_REST) {
+        return true;
+    }
+
+    /* Fold the following rests into this one */
+    melody_cursor_t peek = *cursor;
+    melody_step_t next;
+    while (raw_next(&peek, &next) && next.freq_hz == MELODY_REST) {
+        step->duration_ms += next.duration_ms;
+        *cursor = peek;
+    }
+    return true;
+}
+
+uint32_t melody_duration_ms(const melody_t *melody) {
+    uint32_t play_ms = 0;
+    for (size_t i = 0; i < melody->note_count; i++) {
+        play_ms += melody->notes[i].duration_ms;
+    }
+    uint8_t plays = melody_plays(melody);
+    return play_ms * plays + (uint32_t)melody->gap_ms * (plays - 1);
+}
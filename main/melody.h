@@ -0,0 +1,108 @@
+#ifndef MELODY_H
+#define MELODY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Melody tables and the sequencer that walks them.
+ *
+ * A melody is a const table of notes plus how often to play it and the
+ * volume envelope of each note. melody_next() turns it into a flat list of
+ * steps, each with a start offset from the beginning of playback, so the
+ * player can aim every step at an absolute time and never accumulates
+ * drift. It has no hardware dependencies: buzzer.c drives LEDC from the
+ * steps, and host/melody_render.c renders them to a WAV file.
+ */
+
+/**
+ * Selectable melodies
+ */
+typedef enum {
+    MELODY_CLASSIC,   /* The original five note alarm, played once */
+    MELODY_CHIME,     /* Westminster quarters with a bell-like decay, twice */
+    MELODY_BEEPS,     /* Kitchen timer beeps, three bursts */
+    MELODY_COUNT
+} melody_id_t;
+
+/* Rest: a note with this frequency is silent */
+#define MELODY_REST 0
+
+/**
+ * One note of a melody table
+ */
+typedef struct {
+    uint16_t freq_hz;      /* MELODY_REST for silence */
+    uint16_t duration_ms;
+    uint8_t volume_pct;    /* Peak level, 100 = loudest */
+} melody_note_t;
+
+/**
+ * Volume envelope applied to every note: the note starts at its peak
+ * level and falls linearly to sustain_pct of it over decay_ms.
+ * sustain_pct 100 (or decay_ms 0) holds the level.
+ */
+typedef struct {
+    uint16_t decay_ms;
+    uint8_t sustain_pct;
+} melody_envelope_t;
+
+/**
+ * Melody table
+ */
+typedef struct {
+    const char *name;
+    const melody_note_t *notes;
+    uint8_t note_count;
+    uint8_t plays;          /* Times through the table, at least 1 */
+    uint16_t gap_ms;        /* Silence between two plays */
+    melody_envelope_t envelope;
+} melody_t;
+
+/**
+ * One step of playback: a note or a (merged) silence
+ */
+typedef struct {
+    uint32_t start_ms;      /* Offset from the start of playback */
+    uint32_t duration_ms;
+    uint16_t freq_hz;       /* MELODY_REST for silence */
+    uint8_t peak_pct;       /* Level at the start of the step */
+    uint8_t sustain_pct;    /* Level reached after decay_ms */
+    uint16_t decay_ms;      /* Linear ramp from peak to sustain, <= duration */
+} melody_step_t;
+
+/**
+ * Playback position. Plain data, owned by the caller.
+ */
+typedef struct {
+    const melody_t *melody;
+    uint16_t note;          /* Next note in the table */
+    uint8_t play;           /* Plays completed */
+    bool gap_pending;       /* The gap after a play has not been emitted yet */
+    uint32_t at_ms;         /* Start offset of the next step */
+} melody_cursor_t;
+
+/**
+ * Melody table for an ID, or NULL if out of range
+ */
+const melody_t *melody_get(melody_id_t id);
+
+/**
+ * Rewind a cursor to the start of a melody
+ */
+void melody_start(melody_cursor_t *cursor, const melody_t *melody);
+
+/**
+ * Produce the next step and advance. Consecutive rests and gaps are merged
+ * into one silent step, so silence costs the player a single wakeup.
+ *
+ * @return false when the melody has ended
+ */
+bool melody_next(melody_cursor_t *cursor, melody_step_t *step);
+
+/**
+ * Total length of a melody, including gaps
+ */
+uint32_t melody_duration_ms(const melody_t *melody);
+
+#endif /* MELODY_H */
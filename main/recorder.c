@@ -0,0 +1,77 @@
+#include "recorder.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+_Static_assert(EVT_COUNT <= UINT8_MAX && STATE_COUNT <= UINT8_MAX, "entry fields too narrow");
+
+static recorder_entry_t s_ring[RECORDER_CAPACITY];
+static size_t s_head = 0;         /* Oldest entry */
+static size_t s_count = 0;
+static uint32_t s_overwritten = 0;
+
+/* Logic state just before the oldest entry in the ring */
+static app_state_t s_base;
+
+void recorder_init(const app_state_t *state) {
+    s_base = *state;
+    s_head = 0;
+    s_count = 0;
+    s_overwritten = 0;
+}
+
+void recorder_record(logic_event_t event, int32_t value, int64_t now_us, uint32_t actions,
+                     const app_state_t *after) {
+    if (s_count == RECORDER_CAPACITY) {
+        /* Move the base state past the entry about to be overwritten */
+        const recorder_entry_t *oldest = &s_ring[s_head];
+        logic_process_event(&s_base, (logic_event_t)oldest->event, oldest->value, oldest->now_us);
+        s_head = (s_head + 1) % RECORDER_CAPACITY;
+        s_count--;
+        s_overwritten++;
+    }
+
+    s_ring[(s_head + s_count) % RECORDER_CAPACITY] = (recorder_entry_t){
+        .now_us = now_us,
+        .value = value,
+        .actions = (uint16_t)actions,
+        .event = (uint8_t)event,
+        .state_after = (uint8_t)after->state,
+    };
+    s_count++;
+}
+
+size_t recorder_dump(recorder_write_fn_t write) {
+    char line[192];
+    int len;
+
+    len = snprintf(line, sizeof(line), RECORDER_LINE_PREFIX "begin %d %u %" PRIu32 "\n",
+                   RECORDER_FORMAT, (unsigned)s_count, s_overwritten);
+    write(line, (size_t)len);
+
+    /* state target remaining deadline_us last_encoder flash timer_count
+     * followed by deadline_us duration_secs per brew */
+    len = snprintf(line, sizeof(line), RECORDER_LINE_PREFIX "base %d %" PRIu32 " %" PRIu32 " %" PRId64 " %" PRId32 " %d %u",
+                   (int)s_base.state, s_base.target_time_secs, s_base.remaining_time_secs, s_base.deadline_us,
+                   s_base.last_encoder_count, s_base.alarm_flash_on ? 1 : 0, (unsigned)s_base.timer_count);
+    for (uint8_t i = 0; i < s_base.timer_count && len < (int)sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - (size_t)len, " %" PRId64 " %" PRIu32,
+                        s_base.timers[i].deadline_us, s_base.timers[i].duration_secs);
+    }
+    if (len < (int)sizeof(line) - 1) {
+        line[len++] = '\n';
+        write(line, (size_t)len);
+    }
+
+    for (size_t i = 0; i < s_count; i++) {
+        const recorder_entry_t *entry = &s_ring[(s_head + i) % RECORDER_CAPACITY];
+        /* now_us event value actions state_after */
+        len = snprintf(line, sizeof(line), RECORDER_LINE_PREFIX "ev %" PRId64 " %u %" PRId32 " %u %u\n",
+                       entry->now_us, entry->event, entry->value, entry->actions, entry->state_after);
+        write(line, (size_t)len);
+    }
+
+    len = snprintf(line, sizeof(line), RECORDER_LINE_PREFIX "end %u\n", (unsigned)s_count);
+    write(line, (size_t)len);
+    return s_count;
+}
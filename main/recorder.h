@@ -0,0 +1,70 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "logic.h"
+
+/*
+ * Input recorder for field diagnostics.
+ *
+ * Every event the main loop feeds to logic_process_event() is stored with
+ * the time it was processed, the actions it produced and the state it left,
+ * in a fixed ring of RECORDER_CAPACITY entries. The ring also keeps the
+ * logic state from just before its oldest entry: when an entry is
+ * overwritten it is applied to that base state, which is cheap because the
+ * logic is a pure function. A dump is therefore always replayable from
+ * its first line.
+ *
+ * recorder_dump() writes text lines starting with RECORDER_LINE_PREFIX,
+ * which host/replay reads back out of a serial log.
+ */
+
+#define RECORDER_CAPACITY     512
+#define RECORDER_LINE_PREFIX  "#REC "
+#define RECORDER_FORMAT       1
+
+/**
+ * One processed event
+ */
+typedef struct {
+    int64_t now_us;        /* Time passed to logic_process_event() */
+    int32_t value;
+    uint16_t actions;      /* logic_action_t bits returned */
+    uint8_t event;         /* logic_event_t */
+    uint8_t state_after;   /* tea_state_t */
+} recorder_entry_t;
+
+/**
+ * Output sink for recorder_dump(): writes one complete line
+ */
+typedef void (*recorder_write_fn_t)(const char *line, size_t len);
+
+/**
+ * Empty the ring and take state as the starting point of the recording
+ */
+void recorder_init(const app_state_t *state);
+
+/**
+ * Record an event after logic_process_event() has handled it. Main loop
+ * only.
+ *
+ * @param event    Event passed to the logic
+ * @param value    Event value passed to the logic
+ * @param now_us   Time passed to the logic
+ * @param actions  Actions it returned
+ * @param after    State after the event
+ */
+void recorder_record(logic_event_t event, int32_t value, int64_t now_us, uint32_t actions,
+                     const app_state_t *after);
+
+/**
+ * Write the base state and every recorded entry, oldest first.
+ * Main loop only.
+ *
+ * @return Number of entries written
+ */
+size_t recorder_dump(recorder_write_fn_t write);
+
+#endif /* RECORDER_H */
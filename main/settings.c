@@ -0,0 +1,73 @@
+#include "settings.h"
+
+#include <string.h>
+
+#include "hal.h"
+
+static const char *TAG = "settings";
+
+/* Stored layout. Bump the version when settings_t changes; an older
+ * record is then ignored and the defaults apply. */
+#define SETTINGS_VERSION  1
+
+typedef struct {
+    uint32_t version;
+    settings_t settings;
+} settings_record_t;
+
+static settings_t s_settings;
+static settings_t s_stored;        /* What storage holds, valid if s_stored_valid */
+static bool s_stored_valid = false;
+static settings_stats_t s_stats;
+
+const settings_t *settings_load(const settings_t *defaults) {
+    settings_record_t record;
+    s_settings = *defaults;
+    s_stored_valid = hal_storage_load(&record, sizeof(record)) && record.version == SETTINGS_VERSION;
+    if (s_stored_valid) {
+        s_stored = record.settings;
+        s_settings = record.settings;
+    } else {
+        HAL_LOGI(TAG, "No stored settings, using defaults");
+    }
+    return &s_settings;
+}
+
+const settings_t *settings_get(void) {
+    return &s_settings;
+}
+
+bool settings_set_target(uint32_t target_time_secs) {
+    if (s_settings.target_time_secs == target_time_secs) {
+        return false;
+    }
+    s_settings.target_time_secs = target_time_secs;
+    s_stats.changes++;
+    return true;
+}
+
+bool settings_dirty(void) {
+    return !s_stored_valid || memcmp(&s_stored, &s_settings, sizeof(s_settings)) != 0;
+}
+
+void settings_commit(void) {
+    if (!settings_dirty()) {
+        return;
+    }
+    settings_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.version = SETTINGS_VERSION;
+    record.settings = s_settings;
+    if (!hal_storage_save(&record, sizeof(record))) {
+        s_stats.failures++;
+        HAL_LOGE(TAG, "Saving settings failed");
+        return;
+    }
+    s_stored = s_settings;
+    s_stored_valid = true;
+    s_stats.commits++;
+}
+
+void settings_get_stats(settings_stats_t *stats) {
+    *stats = s_stats;
+}
@@ -0,0 +1,74 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Settings kept across power cycles, in one record in HAL storage (NVS on
+ * the device).
+ *
+ * The main loop reports every change, which only updates the RAM copy. The
+ * record is written by settings_commit(), which the loop calls once the
+ * encoder has been still for a while and before sleep, so turning the dial
+ * never waits on a flash write. A commit that would store what is already
+ * stored is skipped.
+ *
+ * Only the main loop may call the setters and settings_commit().
+ */
+
+/**
+ * Persistent settings
+ */
+typedef struct {
+    uint32_t target_time_secs;    /* Brew time last dialled in */
+} settings_t;
+
+/**
+ * Write accounting. A naive implementation would write once per change.
+ */
+typedef struct {
+    uint32_t changes;    /* Setter calls that changed a value */
+    uint32_t commits;    /* Records written to storage */
+    uint32_t failures;   /* Writes the storage rejected */
+} settings_stats_t;
+
+/**
+ * Read the stored record, once, at boot. Falls back to defaults when
+ * nothing valid is stored.
+ *
+ * @param defaults  Values to use for anything not stored
+ * @return The settings now in effect
+ */
+const settings_t *settings_load(const settings_t *defaults);
+
+/**
+ * Settings in effect, including uncommitted changes
+ */
+const settings_t *settings_get(void);
+
+/**
+ * Note the brew time the user dialled in.
+ *
+ * @return true if this differs from the previous value, i.e. a commit
+ *         should be scheduled
+ */
+bool settings_set_target(uint32_t target_time_secs);
+
+/**
+ * True when the settings differ from the stored record
+ */
+bool settings_dirty(void);
+
+/**
+ * Write the settings to storage if they differ from the stored record.
+ * Blocks for the flash write.
+ */
+void settings_commit(void);
+
+/**
+ * Write accounting since boot
+ */
+void settings_get_stats(settings_stats_t *stats);
+
+#endif /* SETTINGS_H */
@@ -1,18 +1,16 @@
-#include <bsp/esp-bsp.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/queue.h>
-
-#include <esp_log.h>
-#include <esp_timer.h>
-#include <driver/pulse_cnt.h>
-
-#include <lvgl.h>
-#include <iot_button.h>
-#include <button_gpio.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 
+#include "hal.h"
 #include "view.h"
 #include "logic.h"
+#include "event_bus.h"
+#include "trace.h"
+#include "recorder.h"
+#include "latency.h"
+#include "settings.h"
 
 // Uncomment to rotate UI: 90, 180, or 270 degrees. Useful if you need to mount the
 // device in a non-standard orientation.
@@ -21,62 +19,432 @@
 // Comment out to disable sound output when the alarm triggers
 #define USE_BUZZER 1
 
-#if USE_BUZZER
-#include "buzzer.h"
+// Alarm melody: MELODY_CLASSIC, MELODY_CHIME or MELODY_BEEPS (see melody.c)
+#define ALARM_MELODY MELODY_CLASSIC
+
+// Uncomment to count the last 10 seconds of a brew down in tenths ("9.3")
+//#define SHOW_TENTHS 1
+
+#ifndef SHOW_TENTHS
+#define SHOW_TENTHS 0
+#endif
+
+#ifndef ROTATE_UI
+#define ROTATE_UI 0
+#elif ROTATE_UI != 0 && ROTATE_UI != 90 && ROTATE_UI != 180 && ROTATE_UI != 270
+#error "ROTATE_UI must be 0, 90, 180, or 270"
 #endif
 
 static const char *TAG = "tea_timer";
 
-/* Event types for thread-safe event loop */
+/* Refresh timer: the one timer that wakes the loop while something on
+ * screen is counting down or flashing */
+static hal_timer_t s_refresh_timer = NULL;
+
+/* Inactivity timeout (1 minutes) */
+#define INACTIVITY_TIMEOUT_MS  (60 * 1000)
+static hal_timer_t s_inactivity_timer = NULL;
+
+/* Settings are written once the dial has been still this long, or before
+ * sleep, so a turn of several detents costs one flash write */
+#define SETTINGS_COMMIT_DELAY_MS  (3 * 1000)
+static hal_timer_t s_settings_timer = NULL;
+
+/* Retry delay when a tick could not be queued */
+#define TICK_RETRY_US  (10 * 1000)
+
+/* Alarm flash phase length */
+#define FLASH_PERIOD_US  (500 * 1000)
+
+/* How far a flash phase may move to share a wakeup with a tick. Ticks
+ * never move: the last one must arrive at the deadline. */
+#define FLASH_SLACK_US  (50 * 1000)
+
+/**
+ * What the countdown tick follows
+ */
 typedef enum {
-    EVENT_NONE,
-    EVENT_BUTTON_PRESS,
-    EVENT_ENCODER_CHANGE,  // .value holds new absolute count
-    EVENT_TICK_1HZ,        // For countdown
-    EVENT_TICK_FAST,       // For alarm flashing (4Hz)
-    EVENT_INACTIVITY       // For sleep timeout
-} event_type_t;
+    REFRESH_TICK_OFF,        /* No brews running */
+    REFRESH_TICK_COUNTDOWN,  /* Every change of the displayed remaining time */
+    REFRESH_TICK_DEADLINE,   /* Only the end of the soonest brew (the alarm screen shows no countdown) */
+} refresh_tick_t;
 
+/**
+ * What the refresh timer follows
+ */
 typedef struct {
-    event_type_t type;
-    int32_t value;
-} app_event_t;
+    refresh_tick_t tick;
+    int64_t deadline_us;     /* Soonest brew, when tick is not OFF */
+    int64_t from_us;         /* First tick is the first step after this */
+    bool flash;              /* Alarm flashing */
+    int64_t flash_start_us;  /* First flash toggle, origin of the flash grid */
+} refresh_plan_t;
+
+/* Published refresh plan, written by the loop only. seq is odd while the
+ * loop writes it; a new even value tells the timer callback to start over
+ * from the plan. */
+static struct {
+    atomic_uint seq;
+    _Atomic(refresh_tick_t) tick;
+    _Atomic int64_t deadline_us;
+    _Atomic int64_t from_us;
+    atomic_bool flash;
+    _Atomic int64_t flash_start_us;
+} s_refresh_plan;
+
+/* Refresh timer callback state and counters */
+static struct {
+    unsigned seq;                /* Plan the next times below follow */
+    int64_t tick_next_us;
+    int64_t flash_start_us;      /* Grid flash_next_us is on */
+    int64_t flash_next_us;
+    uint32_t wakeups;
+    uint32_t ticks;
+    uint32_t flashes;
+    uint32_t shared;             /* Wakeups that posted a tick and a flash */
+} s_refresh;
+
+/**
+ * Publish a new plan. Loop only.
+ */
+static void refresh_plan_publish(const refresh_plan_t *plan) {
+    unsigned seq = atomic_load_explicit(&s_refresh_plan.seq, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&s_refresh_plan.tick, plan->tick, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.deadline_us, plan->deadline_us, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.from_us, plan->from_us, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.flash, plan->flash, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.flash_start_us, plan->flash_start_us, memory_order_relaxed);
+    atomic_store_explicit(&s_refresh_plan.seq, seq + 2, memory_order_release);
+}
 
-/* Event queue handle */
-static QueueHandle_t s_event_queue = NULL;
+/**
+ * Take a consistent copy of the published plan. Does not wait: the timer
+ * task may have preempted the loop mid-write on the same core.
+ *
+ * @return the plan's sequence count, or an odd value if the loop was
+ *         writing it, in which case the loop arms the timer once it is done
+ */
+static unsigned refresh_plan_read(refresh_plan_t *plan) {
+    unsigned seq = atomic_load_explicit(&s_refresh_plan.seq, memory_order_acquire);
+    if (seq & 1) {
+        return seq;
+    }
+    plan->tick = atomic_load_explicit(&s_refresh_plan.tick, memory_order_relaxed);
+    plan->deadline_us = atomic_load_explicit(&s_refresh_plan.deadline_us, memory_order_relaxed);
+    plan->from_us = atomic_load_explicit(&s_refresh_plan.from_us, memory_order_relaxed);
+    plan->flash = atomic_load_explicit(&s_refresh_plan.flash, memory_order_relaxed);
+    plan->flash_start_us = atomic_load_explicit(&s_refresh_plan.flash_start_us, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&s_refresh_plan.seq, memory_order_relaxed) != seq) {
+        return seq | 1;
+    }
+    return seq;
+}
 
-/* Timer handles */
-static esp_timer_handle_t s_tick_timer = NULL;
-static esp_timer_handle_t s_fast_timer = NULL;
+/**
+ * Next countdown tick after now_us under a plan
+ */
+static int64_t refresh_next_tick_us(const refresh_plan_t *plan, int64_t now_us) {
+    if (plan->tick == REFRESH_TICK_DEADLINE) {
+        return plan->deadline_us > now_us ? plan->deadline_us : now_us;
+    }
+    return now_us + logic_tick_delay_us(plan->deadline_us, now_us, SHOW_TENTHS);
+}
 
-/* Inactivity timeout (1 minutes) */
-#define INACTIVITY_TIMEOUT_MS  (60 * 1000)
-static uint32_t s_last_activity_ms = 0;
+/**
+ * First point of the plan's flash grid after now_us
+ */
+static int64_t refresh_flash_after_us(const refresh_plan_t *plan, int64_t now_us) {
+    if (plan->flash_start_us > now_us) {
+        return plan->flash_start_us;
+    }
+    int64_t periods = (now_us - plan->flash_start_us) / FLASH_PERIOD_US + 1;
+    return plan->flash_start_us + periods * FLASH_PERIOD_US;
+}
+
+/**
+ * When to wake for the next tick and flash phase, or INT64_MAX if nothing
+ * is planned. A flash close enough after the tick waits for it.
+ */
+static int64_t refresh_wake_us(const refresh_plan_t *plan, int64_t tick_next_us, int64_t flash_next_us) {
+    int64_t wake_us = INT64_MAX;
+    if (plan->tick != REFRESH_TICK_OFF) {
+        wake_us = tick_next_us;
+    }
+    if (plan->flash && flash_next_us + FLASH_SLACK_US < wake_us) {
+        wake_us = flash_next_us;
+    }
+    return wake_us;
+}
 
 /**
- * 1Hz tick timer callback - sends EVENT_TICK_1HZ to queue
+ * Arm the refresh timer for wake_us, or stop it for INT64_MAX
  */
-static void tick_timer_cb(void *arg) {
+static void refresh_arm(int64_t wake_us, int64_t now_us) {
+    if (wake_us == INT64_MAX) {
+        hal_timer_stop(s_refresh_timer);
+    } else {
+        hal_timer_start_once(s_refresh_timer, (uint64_t)(wake_us > now_us ? wake_us - now_us : 0));
+    }
+}
+
+/**
+ * Refresh timer callback - the single scheduler for everything that changes
+ * the screen on its own. Posts EVENT_TICK_1HZ when the displayed countdown
+ * steps (or the next brew ends) and EVENT_TICK_FAST on each flash phase,
+ * then re-arms itself for whichever comes next. The chain does not depend
+ * on the main loop, and a tick that does not fit in the queue is retried,
+ * so the final tick always arrives at the deadline.
+ */
+static void refresh_timer_cb(void *arg) {
     (void)arg;
-    app_event_t evt = { .type = EVENT_TICK_1HZ, .value = 0 };
-    xQueueSendFromISR(s_event_queue, &evt, NULL);
+    refresh_plan_t plan;
+    unsigned seq = refresh_plan_read(&plan);
+    if (seq & 1) {
+        /* Caught the loop publishing; it re-arms the timer when done */
+        return;
+    }
+    int64_t now_us = hal_time_us();
+    s_refresh.wakeups++;
+
+    if (seq != s_refresh.seq) {
+        /* Same times the loop armed the timer for */
+        s_refresh.seq = seq;
+        s_refresh.tick_next_us = refresh_next_tick_us(&plan, plan.from_us);
+        /* Only a new alarm restarts the flash. A replan during the alarm
+         * (a brew ending or cancelled) keeps the phases this callback has
+         * already posted, including one posted early within the slack. */
+        if (plan.flash_start_us != s_refresh.flash_start_us) {
+            s_refresh.flash_start_us = plan.flash_start_us;
+            s_refresh.flash_next_us = plan.flash_start_us;
+        }
+    }
+
+    bool tick_due = plan.tick != REFRESH_TICK_OFF && now_us >= s_refresh.tick_next_us;
+    if (tick_due) {
+        app_event_t evt = { .type = EVENT_TICK_1HZ, .value = 0 };
+        if (hal_event_post(&evt)) {
+            s_refresh.ticks++;
+            s_refresh.tick_next_us = refresh_next_tick_us(&plan, now_us);
+            TRACE(TICK_POST, 1, s_refresh.tick_next_us - now_us);
+        } else {
+            s_refresh.tick_next_us = now_us + TICK_RETRY_US;
+            TRACE(TICK_POST, 0, TICK_RETRY_US);
+        }
+    }
+
+    if (plan.flash && now_us + FLASH_SLACK_US >= s_refresh.flash_next_us) {
+        app_event_t evt = { .type = EVENT_TICK_FAST, .value = 0 };
+        hal_event_post(&evt);
+        s_refresh.flashes++;
+        if (tick_due) {
+            s_refresh.shared++;
+        }
+        /* Phases stay on their grid; one missed while the loop was busy is skipped */
+        do {
+            s_refresh.flash_next_us += FLASH_PERIOD_US;
+        } while (s_refresh.flash_next_us <= now_us);
+    }
+
+    refresh_arm(refresh_wake_us(&plan, s_refresh.tick_next_us, s_refresh.flash_next_us), now_us);
+    /* A plan published while this ran may have been armed over: take it up now */
+    if (atomic_load_explicit(&s_refresh_plan.seq, memory_order_acquire) != seq) {
+        hal_timer_start_once(s_refresh_timer, 0);
+    }
 }
 
 /**
- * Fast tick timer callback - sends EVENT_TICK_FAST to queue
+ * Publish the refresh plan for the application state and arm the timer for
+ * its first wakeup. Called by the loop whenever brews or the alarm start or
+ * stop.
  */
-static void fast_timer_cb(void *arg) {
+static void refresh_replan(const app_state_t *state, int64_t now_us, bool alarm_started) {
+    refresh_plan_t plan = {
+        .tick = REFRESH_TICK_OFF,
+        .deadline_us = state->deadline_us,
+        .from_us = now_us,
+        .flash = state->state == STATE_ALARM,
+        /* The loop is the only writer, so it may read its own last value */
+        .flash_start_us = atomic_load_explicit(&s_refresh_plan.flash_start_us, memory_order_relaxed),
+    };
+    if (state->timer_count > 0) {
+        plan.tick = (state->state == STATE_ALARM) ? REFRESH_TICK_DEADLINE : REFRESH_TICK_COUNTDOWN;
+    }
+    if (alarm_started) {
+        plan.flash_start_us = now_us + FLASH_PERIOD_US;
+    }
+    refresh_plan_publish(&plan);
+    refresh_arm(refresh_wake_us(&plan, refresh_next_tick_us(&plan, now_us), refresh_flash_after_us(&plan, now_us)),
+                now_us);
+}
+
+/**
+ * Log how often the refresh timer woke the loop
+ */
+static void refresh_log_stats(void) {
+    HAL_LOGI(TAG, "Refresh: %" PRIu32 " wakeups, %" PRIu32 " ticks, %" PRIu32 " flashes, %" PRIu32 " shared",
+             s_refresh.wakeups, s_refresh.ticks, s_refresh.flashes, s_refresh.shared);
+}
+
+/**
+ * Inactivity timer callback - sends EVENT_INACTIVITY to queue
+ */
+static void inactivity_timer_cb(void *arg) {
     (void)arg;
-    app_event_t evt = { .type = EVENT_TICK_FAST, .value = 0 };
-    xQueueSendFromISR(s_event_queue, &evt, NULL);
+    app_event_t evt = { .type = EVENT_INACTIVITY, .value = 0 };
+    hal_event_post(&evt);
 }
 
-/* PCNT handles */
-static pcnt_unit_handle_t s_pcnt_unit = NULL;
-static int s_last_polled_encoder = 0;
+/**
+ * Settings timer callback - sends EVENT_SETTINGS_SAVE to queue
+ */
+static void settings_timer_cb(void *arg) {
+    (void)arg;
+    app_event_t evt = { .type = EVENT_SETTINGS_SAVE, .value = 0 };
+    hal_event_post(&evt);
+}
 
-/* Application state (managed by logic module) */
-static app_state_t s_app_state;
+/**
+ * (Re)arm the one-shot inactivity timer, called on every user input
+ */
+static void inactivity_timer_restart(void) {
+    hal_timer_start_once(s_inactivity_timer, (uint64_t)INACTIVITY_TIMEOUT_MS * 1000);
+}
+
+/* Application state (managed by logic module). Kept in retained memory so
+ * the dialled-in time survives sleep and software resets. */
+static HAL_RETAINED app_state_t s_app_state;
+static HAL_RETAINED uint32_t s_app_state_magic;
+#define APP_STATE_MAGIC  0x54454131u  /* "TEA1" */
+
+/* Budget from the waking input to the first frame with the backlight on */
+#define WAKE_FRAME_BUDGET_US  (20 * 1000)
+
+/**
+ * Initialize the application state, keeping the target time from before a
+ * reset if the retained copy is valid, or else from the stored settings
+ * (one storage read). Everything else, including the encoder baseline,
+ * restarts because the PCNT count restarts at zero.
+ */
+static void app_state_restore(void) {
+    uint32_t target = s_app_state.target_time_secs;
+    bool valid = s_app_state_magic == APP_STATE_MAGIC &&
+                 target >= LOGIC_MIN_TIME_SECS && target <= LOGIC_MAX_TIME_SECS;
+
+    logic_init(&s_app_state);
+    const settings_t defaults = { .target_time_secs = s_app_state.target_time_secs };
+    const settings_t *settings = settings_load(&defaults);
+    if (!valid) {
+        target = settings->target_time_secs;
+        valid = target >= LOGIC_MIN_TIME_SECS && target <= LOGIC_MAX_TIME_SECS;
+    }
+    if (valid) {
+        s_app_state.target_time_secs = target;
+        s_app_state.remaining_time_secs = target;
+        HAL_LOGI(TAG, "Restored target time: %" PRIu32 " seconds", target);
+    }
+    s_app_state_magic = APP_STATE_MAGIC;
+}
+
+/* Boot phase timestamps, reported once at startup. The clock starts with
+ * IDF startup, after the ROM and bootloader, which are measured apart. */
+#define BOOT_MARKS_MAX  10
+typedef struct {
+    const char *name;
+    int64_t at_us;
+} boot_mark_t;
+static boot_mark_t s_boot_marks[BOOT_MARKS_MAX];
+static size_t s_boot_mark_count = 0;
+static int64_t s_boot_loader_us = -1;
+
+/* Input init runs in the background, so it is timed separately */
+static int64_t s_inputs_start_us = 0;
+static int64_t s_inputs_end_us = 0;
+
+/**
+ * Record the end of a boot phase
+ */
+static void boot_mark(const char *name) {
+    if (s_boot_mark_count < BOOT_MARKS_MAX) {
+        s_boot_marks[s_boot_mark_count++] = (boot_mark_t){ .name = name, .at_us = hal_time_us() };
+    }
+}
+
+/**
+ * Log every boot phase with its duration
+ */
+static void boot_report(void) {
+    if (s_boot_loader_us >= 0) {
+        HAL_LOGI(TAG, "Boot %-12s    %7" PRId64 " us before the clock started", "bootloader", s_boot_loader_us);
+    } else {
+        HAL_LOGI(TAG, "Boot %-12s    not measured", "bootloader");
+    }
+    int64_t prev_us = 0;
+    for (size_t i = 0; i < s_boot_mark_count; i++) {
+        const boot_mark_t *mark = &s_boot_marks[i];
+        HAL_LOGI(TAG, "Boot %-12s at %7" PRId64 " us (+%" PRId64 " us)",
+                 mark->name, mark->at_us, mark->at_us - prev_us);
+        prev_us = mark->at_us;
+    }
+    HAL_LOGI(TAG, "Boot inputs (background) %" PRId64 "..%" PRId64 " us (%" PRId64 " us)",
+             s_inputs_start_us, s_inputs_end_us, s_inputs_end_us - s_inputs_start_us);
+}
+
+/**
+ * Background part of startup: encoder and button, which are not needed
+ * for the first frame. The event queue must exist before this runs.
+ */
+static void inputs_init(void) {
+    s_inputs_start_us = hal_time_us();
+    hal_encoder_init();
+    hal_button_init();
+    s_inputs_end_us = hal_time_us();
+}
+
+/**
+ * Log event bus counters, for sizing the rings
+ */
+static void event_bus_log_stats(void) {
+    static const char *const ring_names[EVENT_BUS_RING_COUNT] = { "button", "timer" };
+    event_bus_stats_t stats;
+    event_bus_get_stats(&stats);
+    for (size_t i = 0; i < EVENT_BUS_RING_COUNT; i++) {
+        const event_bus_ring_stats_t *ring = &stats.rings[i];
+        HAL_LOGI(TAG, "Event ring %s: %" PRIu32 " posted, %" PRIu32 " dropped, high water %" PRIu32 "/%" PRIu32,
+                 ring_names[i], ring->posted, ring->dropped, ring->high_water, ring->depth);
+    }
+    HAL_LOGI(TAG, "Encoder updates: %" PRIu32 " posted, %" PRIu32 " coalesced",
+             stats.encoder_posted, stats.encoder_coalesced);
+}
+
+/**
+ * Log how many settings writes the debounce saved
+ */
+static void settings_log_stats(void) {
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    HAL_LOGI(TAG, "Settings: %" PRIu32 " changes, %" PRIu32 " written, %" PRIu32 " writes avoided, %" PRIu32 " failed",
+             stats.changes, stats.commits, stats.changes > stats.commits ? stats.changes - stats.commits : 0,
+             stats.failures);
+}
+
+/**
+ * Log the input-to-photon latency per stage
+ */
+static void latency_log_stats(void) {
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        latency_summary_t sum;
+        latency_get((latency_stage_t)stage, &sum);
+        HAL_LOGI(TAG, "Latency %-6s: %" PRIu32 " samples, p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32 " us",
+                 latency_stage_name((latency_stage_t)stage), sum.count, sum.p50_us, sum.p99_us, sum.max_us);
+    }
+}
+
+static void recorder_write_stdout(const char *line, size_t len) {
+    fwrite(line, 1, len, stdout);
+}
 
 /**
  * Map logic state to view state
@@ -91,6 +459,74 @@ static view_state_t state_to_view(tea_state_t state) {
     }
 }
 
+/**
+ * Remaining time in tenths at now_us while the countdown shows tenths, or
+ * -1 before the last LOGIC_TENTHS_SECS of a brew (or without SHOW_TENTHS).
+ * Rounded up like the whole seconds, so "0:10" is followed by "9.9".
+ */
+static int32_t display_tenths_left(int64_t now_us) {
+    if (!SHOW_TENTHS || s_app_state.state != STATE_RUNNING || s_app_state.timer_count == 0 ||
+        now_us >= s_app_state.deadline_us) {
+        return -1;
+    }
+    const int64_t us_per_tenth = LOGIC_US_PER_SEC / 10;
+    int64_t left = (s_app_state.deadline_us - now_us + us_per_tenth - 1) / us_per_tenth;
+    return (left < LOGIC_TENTHS_SECS * 10) ? (int32_t)left : -1;
+}
+
+/**
+ * Post the view model for the current state (see view_post())
+ */
+static void view_post_state(int64_t now_us, const latency_marks_t *marks) {
+    bool counting = s_app_state.state == STATE_RUNNING || s_app_state.state == STATE_ALARM;
+    int32_t tenths_left = display_tenths_left(now_us);
+    const view_model_t model = {
+        .state = state_to_view(s_app_state.state),
+        .time_secs = (tenths_left >= 0) ? (uint32_t)tenths_left / 10
+                     : counting ? s_app_state.remaining_time_secs : s_app_state.target_time_secs,
+        .tenths = (tenths_left >= 0) ? (int8_t)(tenths_left % 10) : -1,
+        .progress = logic_get_progress(&s_app_state),
+        .other_timers = logic_get_other_timers(&s_app_state),
+        .flash_on = s_app_state.alarm_flash_on,
+    };
+    view_post(&model, marks);
+}
+
+/* Time the event loop spent waiting for the display lock. Only a wake and
+ * the first frame still take it; UI updates go through the view mailbox. */
+static struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} s_lock_wait;
+
+/**
+ * Take the display lock, timing the wait
+ */
+static void display_lock(void) {
+    int64_t start_us = hal_mono_us();
+    hal_display_lock();
+    uint32_t waited_us = (uint32_t)(hal_mono_us() - start_us);
+    s_lock_wait.count++;
+    s_lock_wait.total_us += waited_us;
+    if (waited_us > s_lock_wait.max_us) {
+        s_lock_wait.max_us = waited_us;
+    }
+}
+
+/**
+ * Log the view mailbox counters and the loop's display lock waits
+ */
+static void view_log_stats(void) {
+    view_mailbox_stats_t mailbox;
+    view_get_mailbox_stats(&mailbox);
+    HAL_LOGI(TAG, "View mailbox: %" PRIu32 " posts, %" PRIu32 " drawn, %" PRIu32 " replaced, %" PRIu32 " retries",
+             mailbox.posts, mailbox.drains, mailbox.replaced, mailbox.retries);
+    HAL_LOGI(TAG, "Loop display lock: %" PRIu32 " waits, avg %" PRIu32 " us, max %" PRIu32 " us",
+             s_lock_wait.count, s_lock_wait.count ? (uint32_t)(s_lock_wait.total_us / s_lock_wait.count) : 0,
+             s_lock_wait.max_us);
+}
+
 /**
  * Map queue event to logic event
  */
@@ -105,258 +541,220 @@ static logic_event_t event_to_logic(event_type_t type) {
     }
 }
 
-/* Initialize rotary encoder using hardware PCNT */
-void encoder_init(void) {
-  /* Configure PCNT unit */
-  pcnt_unit_config_t unit_config = {
-    .high_limit = INT16_MAX,
-    .low_limit = INT16_MIN,
-  };
-  ESP_ERROR_CHECK(pcnt_new_unit(&unit_config, &s_pcnt_unit));
-
-  /* Configure glitch filter (1000ns = 1us) */
-  pcnt_glitch_filter_config_t filter_config = {
-    .max_glitch_ns = 1000,
-  };
-  ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(s_pcnt_unit, &filter_config));
-
-  /* Configure channel A (edge on GPIO41, level on GPIO40) */
-  pcnt_chan_config_t chan_a_config = {
-    .edge_gpio_num = BSP_ENCODER_A,
-    .level_gpio_num = BSP_ENCODER_B,
-  };
-  pcnt_channel_handle_t pcnt_chan_a = NULL;
-  ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_a_config, &pcnt_chan_a));
-  ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_a,
-    PCNT_CHANNEL_EDGE_ACTION_INCREASE,
-    PCNT_CHANNEL_EDGE_ACTION_DECREASE));
-  ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_a,
-    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
-    PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
-
-  /* Configure channel B (edge on GPIO40, level on GPIO41) for full quadrature */
-  pcnt_chan_config_t chan_b_config = {
-    .edge_gpio_num = BSP_ENCODER_B,
-    .level_gpio_num = BSP_ENCODER_A,
-  };
-  pcnt_channel_handle_t pcnt_chan_b = NULL;
-  ESP_ERROR_CHECK(pcnt_new_channel(s_pcnt_unit, &chan_b_config, &pcnt_chan_b));
-  ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_b,
-    PCNT_CHANNEL_EDGE_ACTION_DECREASE,
-    PCNT_CHANNEL_EDGE_ACTION_INCREASE));
-  ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_b,
-    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
-    PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
-
-  /* Enable and start */
-  ESP_ERROR_CHECK(pcnt_unit_enable(s_pcnt_unit));
-  ESP_ERROR_CHECK(pcnt_unit_clear_count(s_pcnt_unit));
-  ESP_ERROR_CHECK(pcnt_unit_start(s_pcnt_unit));
-
-  ESP_LOGI(TAG, "Hardware PCNT encoder initialized");
-}
+/**
+ * Main loop - event-driven architecture. Every producer (timers, button,
+ * encoder ISR) posts to the event bus, so block until there is work.
+ * Button presses and timer events come out before encoder updates. Runs in
+ * its own task, see hal_loop_start().
+ */
+static void event_loop(void) {
+    app_event_t evt;
+    while (hal_event_receive(&evt)) {
+        latency_marks_t marks = { .posted_us = evt.posted_us, .dequeued_us = (uint32_t)hal_mono_us() };
+        bool user_input = evt.type == EVENT_BUTTON_PRESS || evt.type == EVENT_ENCODER_CHANGE;
+
+        if (evt.type == EVENT_RECORDER_DUMP) {
+            /* Diagnostics only, not an input to the logic. Blocks the loop for
+             * as long as the serial port needs to take the lines. */
+            inactivity_timer_restart();
+            size_t entries = recorder_dump(recorder_write_stdout);
+            fflush(stdout);
+            HAL_LOGI(TAG, "Recorder dumped: %u events", (unsigned)entries);
+            continue;
+        }
+
+        if (evt.type == EVENT_SETTINGS_SAVE) {
+            /* Not an input either: the dial has come to rest */
+            settings_commit();
+            continue;
+        }
+
+        TRACE(EVENT, evt.type, evt.value);
+
+        /* Reset activity timer on user input */
+        if (user_input) {
+            inactivity_timer_restart();
+        }
+
+        /* Convert and process event through logic module */
+        int64_t now_us = hal_time_us();
+        bool waking = s_app_state.state == STATE_SLEEP;
+        logic_event_t logic_evt = event_to_logic(evt.type);
+        uint32_t actions = logic_process_event(&s_app_state, logic_evt, evt.value, now_us);
+        recorder_record(logic_evt, evt.value, now_us, actions, &s_app_state);
+        marks.logic_us = (uint32_t)hal_mono_us();
+        waking = waking && s_app_state.state != STATE_SLEEP;
+
+        /* Each change pushes the commit back, so it happens once the dial rests */
+        if (settings_set_target(s_app_state.target_time_secs)) {
+            hal_timer_start_once(s_settings_timer, (uint64_t)SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+
+        /* Handle requested actions */
+        if (actions & ACTION_BACKLIGHT_OFF) {
+            hal_backlight_set(false);
+            HAL_LOGI(TAG, "Backlight OFF (sleep)");
+        }
+
+        if (actions & ACTION_START_TIMER) {
+            HAL_LOGI(TAG, "Timer started: %" PRIu32 " seconds, %u brews", s_app_state.remaining_time_secs,
+                     (unsigned)s_app_state.timer_count);
+        }
+
+        if (actions & ACTION_STOP_TIMER) {
+            HAL_LOGI(TAG, "Timer stopped");
+        }
+
+        if (actions & ACTION_ALARM_START) {
+            HAL_LOGI(TAG, "Alarm started");
+#if USE_BUZZER
+            hal_buzzer_play_alarm(ALARM_MELODY);
+#endif
+        }
 
-/* Get current encoder count */
-int encoder_get_count(void) {
-  int count = 0;
-  pcnt_unit_get_count(s_pcnt_unit, &count);
-  return count;
+        if (actions & ACTION_ALARM_STOP) {
+#if USE_BUZZER
+            hal_buzzer_stop();
+#endif
+            /* From the click to silence; the log line comes after */
+            if (user_input) {
+                latency_alarm_stopped(evt.posted_us, (uint32_t)hal_mono_us());
+            }
+            HAL_LOGI(TAG, "Alarm stopped");
+        }
+
+        /* One tick chain for all brews, aimed at the soonest one, and the
+         * alarm flash share the refresh timer */
+        if (actions & (ACTION_START_TIMER | ACTION_STOP_TIMER | ACTION_ALARM_START | ACTION_ALARM_STOP)) {
+            refresh_replan(&s_app_state, now_us, actions & ACTION_ALARM_START);
+        }
+
+        /* Update UI if requested, or on every tick while tenths are shown.
+         * The renderer picks the model up on its own; the refresh that draws
+         * it completes the latency sample. */
+        bool tenths = display_tenths_left(now_us) >= 0;
+        if ((actions & (ACTION_UPDATE_UI | ACTION_TOGGLE_FLASH)) || (tenths && evt.type == EVENT_TICK_1HZ)) {
+            view_post_state(now_us, user_input ? &marks : NULL);
+            /* Fast resume: the view objects survived sleep, so only the changed
+             * widgets are redrawn. Flush them now instead of on the next period. */
+            if (waking) {
+                display_lock();
+                view_drain();
+                hal_display_refresh_now();
+                hal_display_unlock();
+            }
+        }
+
+        /* Backlight on only after the new frame is on the panel */
+        if (actions & ACTION_BACKLIGHT_ON) {
+            hal_backlight_set(true);
+            HAL_LOGI(TAG, "Backlight ON (wake)");
+            if (waking) {
+                /* From when the waking input was posted, on the clock that
+                 * fast-forward does not move; wraps like the latency marks */
+                uint32_t wake_us = (uint32_t)hal_mono_us() - evt.posted_us;
+                if (wake_us > WAKE_FRAME_BUDGET_US) {
+                    HAL_LOGW(TAG, "Wake to first frame: %" PRIu32 " us (budget %d us)", wake_us, WAKE_FRAME_BUDGET_US);
+                } else {
+                    HAL_LOGI(TAG, "Wake to first frame: %" PRIu32 " us", wake_us);
+                }
+            }
+        }
+
+        TRACE(EVENT_DONE, actions, s_app_state.state);
+
+        /* Enter low-power sleep last, once the backlight is off */
+        if (actions & ACTION_SLEEP) {
+            /* Commit now rather than let the settings timer wake the unit */
+            hal_timer_stop(s_settings_timer);
+            settings_commit();
+            settings_log_stats();
+            refresh_log_stats();
+            view_log_stats();
+            event_bus_log_stats();
+            latency_log_stats();
+            hal_wake_t wake = hal_sleep_until_input();
+            /* Go back to sleep if the wake does not turn into an input event */
+            if (wake != HAL_WAKE_NONE) {
+                inactivity_timer_restart();
+            }
+            if (wake == HAL_WAKE_ENCODER) {
+                /* The waking edge is not a whole detent, so wake the logic directly */
+                hal_encoder_post();
+            }
+        }
+    }
 }
 
-/* Button callback - sends event to queue, no UI code allowed here */
-static void button_press_cb(void *button_handle, void *usr_data) {
-  ESP_LOGI(TAG, "Button pressed - sending event");
-  app_event_t evt = { .type = EVENT_BUTTON_PRESS, .value = 0 };
-  xQueueSendFromISR(s_event_queue, &evt, NULL);
-}
+/* Application start */
+void app_main(void) {
 
-/* Initialize faceplate button */
-void button_init(void) {
-  const button_config_t btn_cfg = {0};  /* Use defaults */
-  const button_gpio_config_t gpio_cfg = {
-    .gpio_num = BSP_BTN_PRESS,
-    .active_level = 0,  /* Active low */
-  };
+  /* The clock at entry covers IDF startup; the ROM and bootloader ran
+   * before it started */
+  s_boot_loader_us = hal_boot_loader_us();
+  boot_mark("app_main");
 
-  button_handle_t btn = NULL;
-  ESP_ERROR_CHECK(iot_button_new_gpio_device(&btn_cfg, &gpio_cfg, &btn));
-  ESP_ERROR_CHECK(iot_button_register_cb(btn, BUTTON_SINGLE_CLICK, NULL, button_press_cb, NULL));
+  /* Initialize application state, which is also where the input
+   * recording starts */
+  app_state_restore();
+  recorder_init(&s_app_state);
+  boot_mark("settings");
 
-  ESP_LOGI(TAG, "Faceplate button initialized");
-}
+  /* Create event queue before hardware init (callbacks use queue) */
+  if (!hal_event_init()) {
+    HAL_LOGE(TAG, "Failed to create event queue");
+    return;
+  }
 
-/* Application start */
-void app_main(void) {
+  /* Trace records are flushed whenever the CPU would otherwise idle */
+  hal_trace_start();
 
-#if USE_BUZZER
-  /* Initializing the buzzer can turn off the screen backlight, so do it first */
-  ESP_ERROR_CHECK(buzzer_init());
-#endif
+  /* Encoder (PCNT) and button are not needed for the first frame, so bring
+   * them up on the other core while the panel initializes. The buzzer is
+   * initialized on the first alarm. */
+  hal_background_start(inputs_init);
 
   /* Initialize display and start LVGL handling task */
-  lv_display_t *disp = bsp_display_start();
-  if (disp == NULL) {
-    ESP_LOGE(TAG, "bsp_display_start() failed");
+  if (!hal_display_start(ROTATE_UI)) {
     return;
   }
+  boot_mark("display");
 
-#ifdef ROTATE_UI
-#if ROTATE_UI == 90
-  bsp_display_rotate(disp, LV_DISPLAY_ROTATION_90);
-#elif ROTATE_UI == 180
-  bsp_display_rotate(disp, LV_DISPLAY_ROTATION_180);
-#elif ROTATE_UI == 270
-  bsp_display_rotate(disp, LV_DISPLAY_ROTATION_270);
-#elif ROTATE_UI != 0
-  #error "ROTATE_UI must be 0, 90, 180, or 270"
-#endif
-#endif
+  /* Initialize tea timer UI and flush the first frame straight away, so
+   * the backlight never shows an empty or stale panel */
+  view_init();
+  boot_mark("view_init");
+  view_post_state(hal_time_us(), NULL);
+  display_lock();
+  view_drain();
+  hal_display_refresh_now();
+  hal_display_unlock();
+  boot_mark("first_frame");
 
   /* Backlight is enabled separately */
-  bsp_display_backlight_on();
+  hal_backlight_set(true);
+  boot_mark("backlight");
 
-  /* Initialize tea timer UI */
-  view_init();
-  ESP_LOGI(TAG, "Tea timer UI initialized");
+  /* Create timers (not started yet): refresh for the countdown and alarm
+   * flashing, and one-shot inactivity timer re-armed on every user input */
+  s_refresh_timer = hal_timer_create("refresh", refresh_timer_cb, NULL);
+  s_inactivity_timer = hal_timer_create("inactivity", inactivity_timer_cb, NULL);
+  s_settings_timer = hal_timer_create("settings", settings_timer_cb, NULL);
 
-  /* Initialize application state */
-  logic_init(&s_app_state);
+  hal_background_join();
+  boot_mark("ready");
+  boot_report();
 
-  /* Create event queue before hardware init (callbacks use queue) */
-  s_event_queue = xQueueCreate(10, sizeof(app_event_t));
-  if (s_event_queue == NULL) {
-    ESP_LOGE(TAG, "Failed to create event queue");
-    return;
-  }
+  /* Commands can inject input, so only once the inputs are up */
+  hal_console_start();
 
-  /* Create 1Hz tick timer (not started yet) */
-  const esp_timer_create_args_t tick_timer_args = {
-    .callback = tick_timer_cb,
-    .arg = NULL,
-    .dispatch_method = ESP_TIMER_TASK,
-    .name = "tick_1hz"
-  };
-  ESP_ERROR_CHECK(esp_timer_create(&tick_timer_args, &s_tick_timer));
-
-  /* Create fast timer for alarm flashing (not started yet) */
-  const esp_timer_create_args_t fast_timer_args = {
-    .callback = fast_timer_cb,
-    .arg = NULL,
-    .dispatch_method = ESP_TIMER_TASK,
-    .name = "tick_fast"
-  };
-  ESP_ERROR_CHECK(esp_timer_create(&fast_timer_args, &s_fast_timer));
-
-  /* Initialize rotary encoder with hardware PCNT */
-  encoder_init();
-
-  /* Initialize faceplate button */
-  button_init();
-
-  /* Initial UI update */
-  bsp_display_lock(0);
-  view_update(state_to_view(s_app_state.state),
-              s_app_state.target_time_secs,
-              logic_get_progress(&s_app_state));
-  bsp_display_unlock();
+  /* Everything the loop needs exists now; in the zero-heap build, nothing
+   * may allocate from here on */
+  hal_heap_freeze();
 
   /* Initialize activity tracking */
-  s_last_activity_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-
-  /* Main loop - event-driven architecture */
-  while (1) {
-    uint32_t current_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-
-    /* 1. Poll encoder and send event if changed */
-    int count = encoder_get_count();
-    if (count != s_last_polled_encoder) {
-      app_event_t evt = { .type = EVENT_ENCODER_CHANGE, .value = count };
-      xQueueSend(s_event_queue, &evt, 0);
-      s_last_polled_encoder = count;
-    }
+  inactivity_timer_restart();
 
-    /* 2. Check for inactivity timeout (only in SETUP state) */
-    if (s_app_state.state == STATE_SETUP) {
-      if ((current_ms - s_last_activity_ms) >= INACTIVITY_TIMEOUT_MS) {
-        app_event_t evt = { .type = EVENT_INACTIVITY, .value = 0 };
-        xQueueSend(s_event_queue, &evt, 0);
-        /* Reset to prevent repeated timeout events */
-        s_last_activity_ms = current_ms;
-      }
-    }
-
-    /* 3. Process events from queue (10ms timeout allows encoder polling) */
-    app_event_t evt;
-    if (xQueueReceive(s_event_queue, &evt, pdMS_TO_TICKS(10))) {
-      /* Reset activity timer on user input */
-      if (evt.type == EVENT_BUTTON_PRESS || evt.type == EVENT_ENCODER_CHANGE) {
-        s_last_activity_ms = current_ms;
-      }
-
-      /* Convert and process event through logic module */
-      logic_event_t logic_evt = event_to_logic(evt.type);
-      uint32_t actions = logic_process_event(&s_app_state, logic_evt, evt.value);
-
-      /* Handle requested actions */
-      if (actions & ACTION_BACKLIGHT_OFF) {
-        bsp_display_backlight_off();
-        ESP_LOGI(TAG, "Backlight OFF (sleep)");
-      }
-
-      if (actions & ACTION_BACKLIGHT_ON) {
-        bsp_display_backlight_on();
-        ESP_LOGI(TAG, "Backlight ON (wake)");
-      }
-
-      if (actions & ACTION_START_TIMER) {
-        ESP_LOGI(TAG, "Timer started: %lu seconds", s_app_state.remaining_time_secs);
-        /* Start 1Hz periodic timer (1,000,000 microseconds = 1 second) */
-        esp_timer_start_periodic(s_tick_timer, 1000000);
-      }
-
-      if (actions & ACTION_STOP_TIMER) {
-        ESP_LOGI(TAG, "Timer stopped");
-        esp_timer_stop(s_tick_timer);
-      }
-
-      if (actions & ACTION_ALARM_START) {
-        ESP_LOGI(TAG, "Alarm started");
-#if USE_BUZZER
-        buzzer_play_alarm();
-#endif
-        /* Start 2Hz fast timer for flashing (500ms) */
-        esp_timer_start_periodic(s_fast_timer, 500 * 1000);
-      }
-
-      if (actions & ACTION_ALARM_STOP) {
-        ESP_LOGI(TAG, "Alarm stopped");
-#if USE_BUZZER
-        buzzer_stop();
-#endif
-        esp_timer_stop(s_fast_timer);
-      }
-
-      if (actions & ACTION_TOGGLE_FLASH) {
-        bsp_display_lock(0);
-        view_set_alarm_flash(s_app_state.alarm_flash_on);
-        bsp_display_unlock();
-      }
-
-      /* Update UI if requested */
-      if (actions & ACTION_UPDATE_UI) {
-        uint32_t display_time = (s_app_state.state == STATE_RUNNING || s_app_state.state == STATE_ALARM)
-                                ? s_app_state.remaining_time_secs
-                                : s_app_state.target_time_secs;
-
-        bsp_display_lock(0);
-        view_update(state_to_view(s_app_state.state),
-                    display_time,
-                    logic_get_progress(&s_app_state));
-        bsp_display_unlock();
-
-        ESP_LOGI(TAG, "State: %d, Time: %lu, Progress: %d",
-                 s_app_state.state, display_time, logic_get_progress(&s_app_state));
-      }
-    }
-  }
+  /* Hand over to the event loop task, pinned apart from LVGL */
+  hal_loop_start(event_loop);
 }
@@ -0,0 +1,133 @@
+#include "trace.h"
+#include "hal.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+_Static_assert((TRACE_RING_RECORDS & (TRACE_RING_RECORDS - 1)) == 0, "ring size must be a power of two");
+
+#define RING_MASK         (TRACE_RING_RECORDS - 1)
+#define RECORD_BYTES      12  /* ts_us:u32 id:u16 arg0:u16 arg1:i32, little endian */
+#define RECORDS_PER_LINE  16
+
+/**
+ * Ring slot. seq is idx + 1 once the record for write index idx is
+ * complete, and 0 while a producer is filling it in.
+ */
+typedef struct {
+    atomic_uint_fast32_t seq;
+    uint32_t ts_us;
+    uint16_t id;
+    uint16_t arg0;
+    int32_t arg1;
+} trace_slot_t;
+
+static trace_slot_t s_ring[TRACE_RING_RECORDS];
+static atomic_uint_fast32_t s_write_idx;  /* Next index to reserve, any producer */
+static uint32_t s_read_idx;               /* Next index to flush, consumer only */
+
+void trace_record(trace_id_t id, uint16_t arg0, int32_t arg1) {
+    uint32_t idx = atomic_fetch_add_explicit(&s_write_idx, 1, memory_order_relaxed);
+    trace_slot_t *slot = &s_ring[idx & RING_MASK];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->ts_us = (uint32_t)hal_time_us();
+    slot->id = (uint16_t)id;
+    slot->arg0 = arg0;
+    slot->arg1 = arg1;
+    atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+}
+
+bool trace_pending(void) {
+    return atomic_load_explicit(&s_write_idx, memory_order_relaxed) != s_read_idx;
+}
+
+static void put_record(uint8_t *out, uint32_t ts_us, uint16_t id, uint16_t arg0, int32_t arg1) {
+    uint32_t a1 = (uint32_t)arg1;
+    out[0] = ts_us;       out[1] = ts_us >> 8;  out[2] = ts_us >> 16; out[3] = ts_us >> 24;
+    out[4] = id;          out[5] = id >> 8;
+    out[6] = arg0;        out[7] = arg0 >> 8;
+    out[8] = a1;          out[9] = a1 >> 8;     out[10] = a1 >> 16;   out[11] = a1 >> 24;
+}
+
+/**
+ * Write one line: prefix, base64 of the packed records, newline
+ */
+static void write_line(trace_write_fn_t write, const uint8_t *data, size_t len) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char line[sizeof(TRACE_LINE_PREFIX) + (RECORDS_PER_LINE * RECORD_BYTES + 2) / 3 * 4 + 1];
+    size_t n = sizeof(TRACE_LINE_PREFIX) - 1;
+    memcpy(line, TRACE_LINE_PREFIX, n);
+
+    /* Records are 12 bytes, so the data is always a multiple of 3 */
+    for (size_t i = 0; i + 2 < len; i += 3) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        line[n++] = b64[(v >> 18) & 0x3F];
+        line[n++] = b64[(v >> 12) & 0x3F];
+        line[n++] = b64[(v >> 6) & 0x3F];
+        line[n++] = b64[v & 0x3F];
+    }
+    line[n++] = '\n';
+    write(line, n);
+}
+
+size_t trace_flush(trace_write_fn_t write) {
+    uint8_t buf[RECORDS_PER_LINE * RECORD_BYTES];
+    size_t buf_records = 0;
+    size_t written = 0;
+    uint32_t lost = 0;
+
+    uint32_t end = atomic_load_explicit(&s_write_idx, memory_order_acquire);
+    if (end - s_read_idx > TRACE_RING_RECORDS) {
+        /* Producers lapped the reader; the oldest records are gone */
+        lost += end - s_read_idx - TRACE_RING_RECORDS;
+        s_read_idx = end - TRACE_RING_RECORDS;
+    }
+
+    while (s_read_idx != end) {
+        trace_slot_t *slot = &s_ring[s_read_idx & RING_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != s_read_idx + 1) {
+            if (seq == 0 || (int32_t)(seq - (s_read_idx + 1)) < 0) {
+                /* Still being written; pick it up next time */
+                break;
+            }
+            /* Overwritten by a newer record */
+            lost++;
+            s_read_idx++;
+            continue;
+        }
+
+        uint32_t ts_us = slot->ts_us;
+        uint16_t id = slot->id;
+        uint16_t arg0 = slot->arg0;
+        int32_t arg1 = slot->arg1;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+            /* Overwritten while it was copied */
+            lost++;
+            s_read_idx++;
+            continue;
+        }
+        s_read_idx++;
+
+        put_record(&buf[buf_records * RECORD_BYTES], ts_us, id, arg0, arg1);
+        written++;
+        if (++buf_records == RECORDS_PER_LINE) {
+            write_line(write, buf, buf_records * RECORD_BYTES);
+            buf_records = 0;
+        }
+    }
+
+    if (lost > 0) {
+        put_record(&buf[buf_records * RECORD_BYTES], (uint32_t)hal_time_us(), TRACE_ID_LOST,
+                   0, (int32_t)lost);
+        buf_records++;
+        written++;
+    }
+    if (buf_records > 0) {
+        write_line(write, buf, buf_records * RECORD_BYTES);
+    }
+    return written;
+}
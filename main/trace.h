@@ -0,0 +1,113 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Deferred binary trace.
+ *
+ * TRACE(id, arg0, arg1) stores a 12 byte record (timestamp, id, two integer
+ * arguments) in a RAM ring. Nothing is formatted on the hot path: the ring is
+ * drained later by trace_flush(), which the device runs from a low priority
+ * task woken by the idle hook, or by the console trace command while the
+ * console is running, and written out as base64 lines prefixed with
+ * TRACE_LINE_PREFIX. host/trace_decode.py turns those lines back into a
+ * Chrome / Perfetto trace JSON, reading the ID table below from this file.
+ *
+ * TRACE_LEVEL selects what is compiled in: 0 = nothing (the default when
+ * NDEBUG is defined), 1 = events and state changes, 2 = also per-frame
+ * display activity. Calls above the level, and their arguments, are removed
+ * at compile time.
+ */
+
+#ifndef TRACE_LEVEL
+#ifdef NDEBUG
+#define TRACE_LEVEL 0
+#else
+#define TRACE_LEVEL 1
+#endif
+#endif
+
+/**
+ * Trace points: X(name, level, phase, track, arg0 name, arg1 name)
+ * phase is the Chrome trace phase: 'B' begin, 'E' end, 'i' instant.
+ * track is the timeline row the decoder puts the point on; begin/end pairs
+ * must share one, and the track must be one context at a time or pairs from
+ * two of them interleave. "main" is the event loop task; "lvgl" is whoever
+ * holds the display lock, which is where view_update() runs (from the
+ * mailbox). Append new entries at the end so recorded IDs stay decodable.
+ */
+#define TRACE_POINTS(X) \
+    X(LOST,        1, 'i', "trace", "unused", "records")   /* Records overwritten before flush */ \
+    X(EVENT,       1, 'B', "main",  "type", "value")       /* Main loop picked up an event */ \
+    X(EVENT_DONE,  1, 'E', "main",  "actions", "state")    /* Main loop finished with it */ \
+    X(BUTTON,      1, 'i', "input", "unused", "unused")    /* Button click posted */ \
+    X(TICK_POST,   1, 'i', "timer", "posted", "delay_us")  /* Countdown tick posted (or retried) */ \
+    X(VIEW_UPDATE, 1, 'B', "lvgl",  "state", "time_secs")  /* view_update() start */ \
+    X(VIEW_DONE,   1, 'E', "lvgl",  "progress", "others")  /* view_update() end */ \
+    X(FRAME,       2, 'B', "lvgl",  "unused", "unused")    /* LVGL refresh start */ \
+    X(FRAME_DONE,  2, 'E', "lvgl",  "unused", "pixels")    /* LVGL refresh end */
+
+/**
+ * Trace point IDs (TRACE_ID_<name>)
+ */
+typedef enum {
+#define TRACE_X_ID(name, level, phase, track, a0, a1) TRACE_ID_##name,
+    TRACE_POINTS(TRACE_X_ID)
+#undef TRACE_X_ID
+    TRACE_ID_COUNT
+} trace_id_t;
+
+/**
+ * Compile-time level of each trace point (TRACE_LEVEL_OF_<name>)
+ */
+enum {
+#define TRACE_X_LEVEL(name, level, phase, track, a0, a1) TRACE_LEVEL_OF_##name = level,
+    TRACE_POINTS(TRACE_X_LEVEL)
+#undef TRACE_X_LEVEL
+};
+
+/* Prefix of every flushed line, so traces can be picked out of a serial log */
+#define TRACE_LINE_PREFIX "#TRC "
+
+/* Ring size in records (power of two) */
+#define TRACE_RING_RECORDS 256
+
+/**
+ * Record a trace point. Safe from tasks, timer callbacks and ISRs.
+ * Prefer the TRACE() macro, which compiles away when disabled.
+ */
+void trace_record(trace_id_t id, uint16_t arg0, int32_t arg1);
+
+#if TRACE_LEVEL > 0
+#define TRACE(name, arg0, arg1) \
+    do { \
+        if (TRACE_LEVEL_OF_##name <= TRACE_LEVEL) { \
+            trace_record(TRACE_ID_##name, (uint16_t)(arg0), (int32_t)(arg1)); \
+        } \
+    } while (0)
+#else
+#define TRACE(name, arg0, arg1) do { } while (0)
+#endif
+
+/**
+ * Whether records are waiting to be flushed. Cheap enough for an idle hook.
+ */
+bool trace_pending(void);
+
+/**
+ * Output sink for trace_flush(): writes one complete line
+ */
+typedef void (*trace_write_fn_t)(const char *line, size_t len);
+
+/**
+ * Encode all pending records as base64 lines and pass them to write.
+ * Single consumer: call from one context only.
+ *
+ * @return Number of records written
+ */
+size_t trace_flush(trace_write_fn_t write);
+
+#endif /* TRACE_H */
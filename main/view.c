@@ -2,9 +2,21 @@
 #include <bsp/esp-bsp.h>
 #include <lvgl.h>
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <string.h>
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+#include <esp_lvgl_port.h>
+#endif
+
+#include "trace.h"
+#include "latency.h"
+#include "display.h"
 
-/* Set to 1 to use scaled monospace font (stable width), 0 for proportional Montserrat */
-#define USE_MONOSPACED_FONT 0
+/* Font the countdown digits are rasterized from, once, at view_init(). Only
+ * '0'-'9', ':' and '.' are used, so a subset font generated with lv_font_conv
+ * (--range 0x2E,0x30-0x3A) can be dropped in here to save flash. */
+#define DIGIT_FONT (&lv_font_montserrat_48)
 
 static const char *TAG = "view";
 
@@ -19,14 +31,277 @@ static const char *TAG = "view";
 #define COLOR_BG      lv_color_hex(0x000000)  /* Black background */
 #define COLOR_TEXT    lv_color_hex(0xFFFFFF)  /* White text */
 
+/* Countdown glyphs: digits 0-9 followed by the colon and the tenths point */
+#define GLYPH_COLON   10
+#define GLYPH_POINT   11
+#define GLYPH_COUNT   12
+#define TIME_CELLS    5   /* Longest text is "10:00" */
+
 /* UI widget handles */
 static lv_obj_t *s_screen = NULL;
 static lv_obj_t *s_arc = NULL;
-static lv_obj_t *s_time_label = NULL;
+static lv_obj_t *s_time_cells[TIME_CELLS];
+static lv_obj_t *s_time_label = NULL;  /* Used instead of the cells without an atlas */
 static lv_obj_t *s_status_label = NULL;
+static lv_obj_t *s_others_label = NULL;
+
+/* Glyph atlas: one A8 tile per glyph, stacked in a single buffer in internal
+ * RAM. Digits share one cell width so the countdown never shifts. */
+static uint8_t *s_atlas = NULL;
+static lv_image_dsc_t s_glyphs[GLYPH_COUNT];
 
-/* Current state for color management */
-static view_state_t s_current_state = VIEW_STATE_SETUP;
+/* Last rendered content, so updates only touch widgets that changed */
+static struct {
+    bool valid;              /* false until the first view_update() */
+    view_state_t state;
+    uint8_t progress;
+    bool flash_on;
+    uint8_t other_timers;
+    char time_text[8];
+} s_rendered;
+
+/* Flush accounting, updated from the LVGL task */
+static uint32_t s_frame_pixels = 0;
+static int64_t s_frame_start_us = 0;
+static view_flush_stats_t s_flush_stats;
+
+/* End of the last LVGL task activity seen here, for counting the refresh
+ * periods it slept through */
+static int64_t s_active_us = 0;
+
+/**
+ * Note that the LVGL task is at work, counting the refresh periods it has
+ * slept through since it last was
+ */
+static void note_active(int64_t now_us) {
+    int64_t periods = (now_us - s_active_us) / (LV_DEF_REFR_PERIOD * 1000);
+    if (periods > 1) {
+        s_flush_stats.polls_avoided += (uint32_t)(periods - 1);
+    }
+    s_active_us = now_us;
+}
+
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+/* Input device that is never touched: view_kick() has the LVGL port read it
+ * in its task, and the read drains the mailbox. Event mode, so LVGL has no
+ * timer of its own for it. */
+static lv_indev_t *s_doorbell = NULL;
+
+/**
+ * Doorbell read, in the LVGL task with the display lock held
+ */
+static void doorbell_read_cb(lv_indev_t *indev, lv_indev_data_t *data) {
+    (void)indev;
+    data->state = LV_INDEV_STATE_RELEASED;
+    note_active(esp_timer_get_time());
+    s_flush_stats.wakes++;
+    view_drain();
+}
+#else
+/**
+ * Mailbox poll. LVGL pauses its refresh timer while nothing is invalid, so
+ * REFR_START alone would never see a model posted to an idle screen.
+ */
+static void mailbox_timer_cb(lv_timer_t *timer) {
+    (void)timer;
+    note_active(esp_timer_get_time());
+    view_drain();
+}
+#endif
+
+/**
+ * Display event callback: apply the posted view model, count pixels sent to
+ * the panel per frame, and follow the pending input latency sample through
+ * the refresh
+ */
+static void display_event_cb(lv_event_t *e) {
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_REFR_START:
+            /* Widgets changed here are drawn by this refresh */
+            TRACE(FRAME, 0, 0);
+            view_drain();
+            s_frame_start_us = esp_timer_get_time();
+            note_active(s_frame_start_us);
+            latency_frame_start((uint32_t)s_frame_start_us);
+            s_frame_pixels = 0;
+            break;
+
+        case LV_EVENT_FLUSH_START: {
+            latency_flush_start();
+            const lv_area_t *area = lv_event_get_param(e);
+            if (area != NULL) {
+                s_frame_pixels += lv_area_get_size(area);
+            }
+            break;
+        }
+
+        case LV_EVENT_REFR_READY: {
+            int64_t now_us = esp_timer_get_time();
+            uint32_t frame_us = (uint32_t)(now_us - s_frame_start_us);
+            s_flush_stats.frames++;
+            s_flush_stats.last_frame_pixels = s_frame_pixels;
+            s_flush_stats.total_pixels += s_frame_pixels;
+            s_flush_stats.total_frame_us += frame_us;
+            if (frame_us > s_flush_stats.max_frame_us) {
+                s_flush_stats.max_frame_us = frame_us;
+            }
+            TRACE(FRAME_DONE, 0, s_frame_pixels);
+            latency_frame_ready((uint32_t)now_us);
+            s_active_us = now_us;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Rasterize '0'-'9', ':' and '.' once into the glyph atlas. The glyphs are drawn
+ * white on black into L8 tiles, whose luminance is exactly the coverage, and
+ * then used as A8 images that LVGL recolors at blit time. Returns false, with
+ * no glyph descriptors filled in, if the atlas cannot be allocated.
+ */
+static bool digit_atlas_build(void) {
+    static const char *const glyph_text[GLYPH_COUNT] = {
+        "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":", "."
+    };
+
+    /* Cell sizes: widest digit for all digits, punctuation gets its own width */
+    int32_t digit_w = 0;
+    for (int i = 0; i < GLYPH_COLON; i++) {
+        int32_t w = lv_font_get_glyph_width(DIGIT_FONT, '0' + i, 0);
+        if (w > digit_w) {
+            digit_w = w;
+        }
+    }
+    int32_t colon_w = lv_font_get_glyph_width(DIGIT_FONT, ':', 0);
+    int32_t point_w = lv_font_get_glyph_width(DIGIT_FONT, '.', 0);
+    int32_t cell_h = lv_font_get_line_height(DIGIT_FONT);
+
+    /* Rows padded to 4 bytes so every tile starts aligned */
+    uint32_t digit_stride = (digit_w + 3) & ~3;
+    uint32_t colon_stride = (colon_w + 3) & ~3;
+    uint32_t point_stride = (point_w + 3) & ~3;
+    size_t atlas_size = (GLYPH_COLON * digit_stride + colon_stride + point_stride) * cell_h;
+
+    s_atlas = heap_caps_calloc(1, atlas_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (s_atlas == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte glyph atlas", (unsigned)atlas_size);
+        return false;
+    }
+
+    /* Off-screen canvas used only to draw into each tile in turn */
+    lv_obj_t *canvas = lv_canvas_create(s_screen);
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+    lv_draw_buf_t draw_buf;
+    uint8_t *tile = s_atlas;
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        int32_t w = (i == GLYPH_COLON) ? colon_w : (i == GLYPH_POINT) ? point_w : digit_w;
+        uint32_t stride = (i == GLYPH_COLON) ? colon_stride : (i == GLYPH_POINT) ? point_stride : digit_stride;
+        uint32_t tile_size = stride * cell_h;
+
+        lv_draw_buf_init(&draw_buf, w, cell_h, LV_COLOR_FORMAT_L8, stride, tile, tile_size);
+        lv_canvas_set_draw_buf(canvas, &draw_buf);
+
+        lv_layer_t layer;
+        lv_canvas_init_layer(canvas, &layer);
+        lv_draw_label_dsc_t label_dsc;
+        lv_draw_label_dsc_init(&label_dsc);
+        label_dsc.font = DIGIT_FONT;
+        label_dsc.color = lv_color_white();
+        label_dsc.align = LV_TEXT_ALIGN_CENTER;
+        label_dsc.text = glyph_text[i];
+        lv_area_t area = { 0, 0, w - 1, cell_h - 1 };
+        lv_draw_label(&layer, &label_dsc, &area);
+        lv_canvas_finish_layer(canvas, &layer);
+
+        s_glyphs[i] = (lv_image_dsc_t){
+            .header = {
+                .magic = LV_IMAGE_HEADER_MAGIC,
+                .cf = LV_COLOR_FORMAT_A8,
+                .w = w,
+                .h = cell_h,
+                .stride = stride,
+            },
+            .data_size = tile_size,
+            .data = tile,
+        };
+        tile += tile_size;
+    }
+    lv_obj_delete(canvas);
+
+    ESP_LOGI(TAG, "Glyph atlas: %dx%d digits, %u bytes", (int)digit_w, (int)cell_h, (unsigned)atlas_size);
+    return true;
+}
+
+/**
+ * Atlas index for a countdown character
+ */
+static int glyph_index(char c) {
+    return (c == ':') ? GLYPH_COLON : (c == '.') ? GLYPH_POINT : c - '0';
+}
+
+/**
+ * Show text ("M:SS", "MM:SS" or "S.T") in the time cells. Only cells whose glyph
+ * changed get a new image source, so only those cells are redrawn; cells are
+ * re-laid out only when the text length changes.
+ */
+static void time_cells_set(const char *text) {
+    if (s_time_label != NULL) {
+        lv_label_set_text(s_time_label, text);
+        return;
+    }
+
+    static size_t shown_len = 0;
+    static char shown[TIME_CELLS];
+    size_t len = strlen(text);
+    if (len > TIME_CELLS) {
+        len = TIME_CELLS;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (len != shown_len || shown[i] != text[i]) {
+            lv_image_set_src(s_time_cells[i], &s_glyphs[glyph_index(text[i])]);
+            shown[i] = text[i];
+        }
+    }
+
+    if (len != shown_len) {
+        /* Center the row on screen */
+        int32_t total_w = 0;
+        for (size_t i = 0; i < len; i++) {
+            total_w += s_glyphs[glyph_index(text[i])].header.w;
+        }
+        int32_t x = -total_w / 2;
+        for (size_t i = 0; i < TIME_CELLS; i++) {
+            if (i < len) {
+                int32_t w = s_glyphs[glyph_index(text[i])].header.w;
+                lv_obj_align(s_time_cells[i], LV_ALIGN_CENTER, x + w / 2, 0);
+                lv_obj_remove_flag(s_time_cells[i], LV_OBJ_FLAG_HIDDEN);
+                x += w;
+            } else {
+                lv_obj_add_flag(s_time_cells[i], LV_OBJ_FLAG_HIDDEN);
+            }
+        }
+        shown_len = len;
+    }
+}
+
+#if !CONFIG_TEA_ALARM_FLASH_PANEL
+/**
+ * Set the countdown text color (recolor of the A8 glyph images)
+ */
+static void time_cells_set_color(lv_color_t color) {
+    if (s_time_label != NULL) {
+        lv_obj_set_style_text_color(s_time_label, color, 0);
+        return;
+    }
+    for (int i = 0; i < TIME_CELLS; i++) {
+        lv_obj_set_style_image_recolor(s_time_cells[i], color, 0);
+    }
+}
+#endif
 
 void view_init(void) {
     ESP_LOGI(TAG, "view_init() starting");
@@ -60,22 +335,24 @@ void view_init(void) {
     lv_obj_set_style_arc_width(s_arc, ARC_WIDTH, LV_PART_MAIN);
     lv_obj_set_style_arc_color(s_arc, lv_color_hex(0x333333), LV_PART_MAIN);
 
-    /* Create time label - center, large font */
-    s_time_label = lv_label_create(s_screen);
-    ESP_LOGI(TAG, "Created time label: %p", s_time_label);
-#if USE_MONOSPACED_FONT
-    /* Scaled monospace font for stable width during countdown */
-    lv_obj_set_style_text_font(s_time_label, &lv_font_unscii_16, 0);
-    lv_obj_set_style_transform_zoom(s_time_label, 512, 0);  /* 2x scale */
-    lv_obj_set_style_transform_pivot_x(s_time_label, LV_PCT(50), 0);
-    lv_obj_set_style_transform_pivot_y(s_time_label, LV_PCT(50), 0);
-#else
-    /* Proportional font - may shift slightly during countdown */
-    lv_obj_set_style_text_font(s_time_label, &lv_font_montserrat_48, 0);
-#endif
-    lv_obj_set_style_text_color(s_time_label, COLOR_TEXT, 0);
-    lv_label_set_text(s_time_label, "5:00");
-    lv_obj_center(s_time_label);
+    /* Create time display - fixed-width cells blitted from the glyph atlas,
+     * or, if it could not be built, a plain label in the same font, which is
+     * slower to draw and lets the text shift but shows the same time */
+    if (digit_atlas_build()) {
+        for (int i = 0; i < TIME_CELLS; i++) {
+            s_time_cells[i] = lv_image_create(s_screen);
+            lv_obj_set_style_image_recolor(s_time_cells[i], COLOR_TEXT, 0);
+            lv_obj_set_style_image_recolor_opa(s_time_cells[i], LV_OPA_COVER, 0);
+            lv_obj_add_flag(s_time_cells[i], LV_OBJ_FLAG_HIDDEN);
+        }
+    } else {
+        ESP_LOGW(TAG, "Countdown falls back to a text label");
+        s_time_label = lv_label_create(s_screen);
+        lv_obj_set_style_text_font(s_time_label, DIGIT_FONT, 0);
+        lv_obj_set_style_text_color(s_time_label, COLOR_TEXT, 0);
+        lv_obj_center(s_time_label);
+    }
+    time_cells_set("5:00");
 
     /* Create status label - bottom, smaller font */
     s_status_label = lv_label_create(s_screen);
@@ -84,18 +361,58 @@ void view_init(void) {
     lv_label_set_text(s_status_label, "SET TIME");
     lv_obj_align(s_status_label, LV_ALIGN_CENTER, 0, 50);
 
+    /* Other brews indicator - above the time, hidden while there are none */
+    s_others_label = lv_label_create(s_screen);
+    lv_obj_set_style_text_color(s_others_label, COLOR_RUNNING, 0);
+    lv_obj_align(s_others_label, LV_ALIGN_CENTER, 0, -50);
+    lv_obj_add_flag(s_others_label, LV_OBJ_FLAG_HIDDEN);
+
+    /* Nothing rendered through view_update() yet */
+    memset(&s_rendered, 0, sizeof(s_rendered));
+    memset(&s_flush_stats, 0, sizeof(s_flush_stats));
+
+    lv_display_t *disp = lv_obj_get_display(s_screen);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_REFR_READY, NULL);
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+    s_doorbell = lv_indev_create();
+    lv_indev_set_type(s_doorbell, LV_INDEV_TYPE_KEYPAD);
+    lv_indev_set_read_cb(s_doorbell, doorbell_read_cb);
+    lv_indev_set_mode(s_doorbell, LV_INDEV_MODE_EVENT);
+#else
+    lv_timer_create(mailbox_timer_cb, LV_DEF_REFR_PERIOD, NULL);
+#endif
+    s_active_us = esp_timer_get_time();
+
     bsp_display_unlock();
     ESP_LOGI(TAG, "view_init() complete");
 }
 
-void view_update(view_state_t state, uint32_t time_secs, uint8_t progress) {
-    ESP_LOGI(TAG, "view_update(state=%d, time=%lu, progress=%d)", state, time_secs, progress);
-
-    /* Reset flash state when not in alarm (ensures clean transition from alarm) */
-    if (state != VIEW_STATE_ALARM) {
+/**
+ * Apply the alarm flash phase, if it differs from what is on screen
+ */
+static void apply_flash(bool flash_on) {
+    if (s_rendered.valid && s_rendered.flash_on == flash_on) {
+        return;
+    }
+#if CONFIG_TEA_ALARM_FLASH_PANEL
+    /* The frame stays as drawn; the panel inverts it */
+    display_invert(flash_on);
+#else
+    if (flash_on) {
+        lv_obj_set_style_bg_color(s_screen, COLOR_ALARM, 0);
+        time_cells_set_color(COLOR_BG);
+    } else {
         lv_obj_set_style_bg_color(s_screen, COLOR_BG, 0);
-        lv_obj_set_style_text_color(s_time_label, COLOR_TEXT, 0);
+        time_cells_set_color(COLOR_TEXT);
     }
+#endif
+    s_rendered.flash_on = flash_on;
+}
+
+void view_update(view_state_t state, uint32_t time_secs, int8_t tenths, uint8_t progress, uint8_t other_timers) {
+    TRACE(VIEW_UPDATE, state, time_secs);
 
     /* Update arc color based on state */
     lv_color_t arc_color;
@@ -116,6 +433,7 @@ void view_update(view_state_t state, uint32_t time_secs, uint8_t progress) {
             break;
         case VIEW_STATE_SLEEP:
             /* Sleep state handled by backlight, not UI */
+            TRACE(VIEW_DONE, progress, other_timers);
             return;
         default:
             arc_color = COLOR_SETUP;
@@ -123,30 +441,65 @@ void view_update(view_state_t state, uint32_t time_secs, uint8_t progress) {
             break;
     }
 
-    s_current_state = state;
+    /* Reset flash state when not in alarm (ensures clean transition from alarm) */
+    if (state != VIEW_STATE_ALARM) {
+        apply_flash(false);
+    }
+
+    /* Each setter invalidates its widget, so only call the ones whose
+     * content differs from the last rendered frame */
+    bool state_changed = !s_rendered.valid || s_rendered.state != state;
+    if (state_changed) {
+        lv_obj_set_style_arc_color(s_arc, arc_color, LV_PART_INDICATOR);
+        lv_label_set_text(s_status_label, status_text);
+    }
 
-    /* Update arc */
-    lv_obj_set_style_arc_color(s_arc, arc_color, LV_PART_INDICATOR);
-    lv_arc_set_value(s_arc, progress);
+    /* The arc only redraws the segment between the old and new value */
+    if (!s_rendered.valid || s_rendered.progress != progress) {
+        lv_arc_set_value(s_arc, progress);
+    }
 
-    /* Update time label */
-    uint32_t minutes = time_secs / 60;
-    uint32_t seconds = time_secs % 60;
-    lv_label_set_text_fmt(s_time_label, "%lu:%02lu", minutes, seconds);
+    char time_text[sizeof(s_rendered.time_text)];
+    if (tenths >= 0) {
+        lv_snprintf(time_text, sizeof(time_text), "%" LV_PRIu32 ".%d", time_secs, tenths);
+    } else {
+        uint32_t minutes = time_secs / 60;
+        uint32_t seconds = time_secs % 60;
+        lv_snprintf(time_text, sizeof(time_text), "%" LV_PRIu32 ":%02" LV_PRIu32, minutes, seconds);
+    }
+    if (!s_rendered.valid || strcmp(s_rendered.time_text, time_text) != 0) {
+        time_cells_set(time_text);
+        strcpy(s_rendered.time_text, time_text);
+    }
 
-    /* Update status label */
-    lv_label_set_text(s_status_label, status_text);
+    if (!s_rendered.valid || s_rendered.other_timers != other_timers) {
+        if (other_timers > 0) {
+            lv_label_set_text_fmt(s_others_label, "+%d", other_timers);
+            lv_obj_remove_flag(s_others_label, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(s_others_label, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
 
-    /* Force screen refresh */
-    lv_obj_invalidate(s_screen);
+    s_rendered.state = state;
+    s_rendered.progress = progress;
+    s_rendered.other_timers = other_timers;
+    s_rendered.valid = true;
+    TRACE(VIEW_DONE, progress, other_timers);
 }
 
 void view_set_alarm_flash(bool flash_on) {
-    if (flash_on) {
-        lv_obj_set_style_bg_color(s_screen, COLOR_ALARM, 0);
-        lv_obj_set_style_text_color(s_time_label, COLOR_BG, 0);
-    } else {
-        lv_obj_set_style_bg_color(s_screen, COLOR_BG, 0);
-        lv_obj_set_style_text_color(s_time_label, COLOR_TEXT, 0);
+    apply_flash(flash_on);
+}
+
+void view_kick(void) {
+#if CONFIG_TEA_DISPLAY_ON_DEMAND
+    if (s_doorbell != NULL) {
+        lvgl_port_task_wake(LVGL_PORT_EVENT_TOUCH, s_doorbell);
     }
+#endif
+}
+
+void view_get_flush_stats(view_flush_stats_t *stats) {
+    *stats = s_flush_stats;
 }
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "latency.h"
+
 /**
  * Tea timer states for UI display
  */
@@ -14,9 +16,44 @@ typedef enum {
     VIEW_STATE_SLEEP     /* Display off */
 } view_state_t;
 
+/**
+ * Everything one frame shows, as posted to the view mailbox
+ */
+typedef struct {
+    view_state_t state;
+    uint32_t time_secs;          /* Target in SETUP, remaining otherwise */
+    int8_t tenths;               /* 0-9 to show "S.T" instead of "M:SS", else -1 */
+    uint8_t progress;            /* Arc progress 0-100 */
+    uint8_t other_timers;        /* Brews running besides the one shown */
+    bool flash_on;               /* Alarm flash phase, ALARM only */
+} view_model_t;
+
+/**
+ * View mailbox counters
+ */
+typedef struct {
+    uint32_t posts;              /* view_post() calls */
+    uint32_t drains;             /* Models applied by view_drain() */
+    uint32_t replaced;           /* Models replaced before they were drawn */
+    uint32_t retries;            /* Reads that caught a post in progress */
+} view_mailbox_stats_t;
+
+/**
+ * Panel flush statistics, for measuring how much each update redraws
+ */
+typedef struct {
+    uint32_t frames;             /* Frames refreshed since view_init() */
+    uint32_t last_frame_pixels;  /* Pixels flushed by the most recent frame */
+    uint64_t total_pixels;       /* Pixels flushed since view_init() */
+    uint32_t max_frame_us;       /* Longest refresh, start to ready */
+    uint64_t total_frame_us;     /* Time spent refreshing since view_init() */
+    uint32_t wakes;              /* LVGL task wakes by view_kick() */
+    uint32_t polls_avoided;      /* Refresh periods the LVGL task slept through */
+} view_flush_stats_t;
+
 /**
  * Initialize the UI elements.
- * Creates arc, time label, and status label.
+ * Creates arc, time label, status label and the other-brews indicator.
  * Must be called after bsp_display_start().
  * Handles its own display locking.
  */
@@ -24,13 +61,17 @@ void view_init(void);
 
 /**
  * Update the UI to reflect current state.
+ * Only widgets whose content changed since the last call are touched, so
+ * LVGL redraws just those areas.
  * Caller MUST hold the display lock before calling.
  *
  * @param state       Current timer state
  * @param time_secs   Time to display (target in SETUP, remaining in RUNNING)
+ * @param tenths      0-9 to show seconds and tenths ("9.3"), -1 for "M:SS"
  * @param progress    Arc progress 0-100 (100 = full circle)
+ * @param other_timers  Brews running besides the one shown, 0 hides the indicator
  */
-void view_update(view_state_t state, uint32_t time_secs, uint8_t progress);
+void view_update(view_state_t state, uint32_t time_secs, int8_t tenths, uint8_t progress, uint8_t other_timers);
 
 /**
  * Toggle the alarm flash state (for ALARM state animation).
@@ -40,4 +81,47 @@ void view_update(view_state_t state, uint32_t time_secs, uint8_t progress);
  */
 void view_set_alarm_flash(bool flash_on);
 
+/**
+ * Post what the screen should show, without waiting for the renderer.
+ * The LVGL task applies the latest model at the start of its next refresh
+ * (view_drain()); a model it has not picked up yet is replaced, so each
+ * widget is drawn once with its newest value. Never blocks. Event loop only.
+ *
+ * @param model  What to show
+ * @param marks  Latency marks of the input behind it, or NULL
+ */
+void view_post(const view_model_t *model, const latency_marks_t *marks);
+
+/**
+ * Apply the latest posted model through view_update() and
+ * view_set_alarm_flash(), if it has not been applied yet. Called by the
+ * LVGL task when view_kick() wakes it (or every refresh period without
+ * render on demand) and at the start of every refresh; the event loop calls
+ * it itself before hal_display_refresh_now() when a frame must reach the
+ * panel at once.
+ * Caller MUST hold the display lock before calling.
+ */
+void view_drain(void);
+
+/**
+ * Wake the renderer to take up a model just posted. Called by view_post();
+ * never blocks. With render on demand (Tea Timer > Display) this is what
+ * wakes the sleeping LVGL task; otherwise the task polls the mailbox every
+ * refresh period and this does nothing.
+ */
+void view_kick(void);
+
+/**
+ * Get view mailbox counters. Safe from any task.
+ */
+void view_get_mailbox_stats(view_mailbox_stats_t *stats);
+
+/**
+ * Get panel flush statistics.
+ * Caller MUST hold the display lock before calling.
+ *
+ * @param stats  Receives a snapshot of the counters
+ */
+void view_get_flush_stats(view_flush_stats_t *stats);
+
 #endif /* VIEW_H */
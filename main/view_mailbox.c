@@ -0,0 +1,95 @@
+/**
+ * View mailbox (see view_post() in view.h): the latest view model, handed
+ * from the event loop to the LVGL task without a lock.
+ *
+ * One writer (the event loop) and one reader at a time (whoever holds the
+ * display lock: the LVGL task at the start of a refresh, or the loop when
+ * it refreshes in place). The model is guarded by a sequence count, odd
+ * while the writer is copying it in. Neither side waits: a reader that
+ * catches the writer mid-copy retries a few times and otherwise leaves the
+ * model for the next refresh.
+ */
+#include "view.h"
+
+#include <stdatomic.h>
+
+#include "hal.h"
+
+/* Attempts to read a consistent model before leaving it for the next refresh */
+#define DRAIN_ATTEMPTS  3
+
+static struct {
+    atomic_uint seq;          /* Odd while the writer is copying */
+    view_model_t model;
+    latency_marks_t marks;    /* Oldest input not drawn yet, if marks_seq is new */
+    unsigned marks_seq;
+    bool has_marks;
+} s_mailbox;
+
+/* Sequence count of the last model drained, written by the reader */
+static atomic_uint s_drained_seq;
+
+static view_mailbox_stats_t s_stats;
+
+void view_post(const view_model_t *model, const latency_marks_t *marks) {
+    unsigned seq = atomic_load_explicit(&s_mailbox.seq, memory_order_relaxed);
+    unsigned drained = atomic_load_explicit(&s_drained_seq, memory_order_acquire);
+    if (seq != drained) {
+        /* The previous model was never drawn */
+        s_stats.replaced++;
+    }
+
+    atomic_store_explicit(&s_mailbox.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s_mailbox.model = *model;
+    /* Keep the input that has waited longest, as latency_frame_pending() does */
+    if (marks != NULL && (!s_mailbox.has_marks || (int)(drained - s_mailbox.marks_seq) >= 0)) {
+        s_mailbox.marks = *marks;
+        s_mailbox.marks_seq = seq + 2;
+        s_mailbox.has_marks = true;
+    }
+    atomic_store_explicit(&s_mailbox.seq, seq + 2, memory_order_release);
+    s_stats.posts++;
+    view_kick();
+}
+
+void view_drain(void) {
+    uint32_t now_us = (uint32_t)hal_mono_us();
+    unsigned drained = atomic_load_explicit(&s_drained_seq, memory_order_relaxed);
+    for (int attempt = 0; attempt < DRAIN_ATTEMPTS; attempt++) {
+        unsigned seq = atomic_load_explicit(&s_mailbox.seq, memory_order_acquire);
+        if (seq == drained) {
+            return;
+        }
+        if (seq & 1) {
+            s_stats.retries++;
+            continue;
+        }
+        view_model_t model = s_mailbox.model;
+        latency_marks_t marks = s_mailbox.marks;
+        bool new_marks = s_mailbox.has_marks && (int)(s_mailbox.marks_seq - drained) > 0;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s_mailbox.seq, memory_order_relaxed) != seq) {
+            s_stats.retries++;
+            continue;
+        }
+
+        view_update(model.state, model.time_secs, model.tenths, model.progress, model.other_timers);
+        if (model.state == VIEW_STATE_ALARM) {
+            view_set_alarm_flash(model.flash_on);
+        }
+        atomic_store_explicit(&s_drained_seq, seq, memory_order_release);
+        s_stats.drains++;
+
+        if (new_marks) {
+            marks.drained_us = now_us;
+            marks.viewed_us = (uint32_t)hal_mono_us();
+            latency_frame_pending(&marks);
+        }
+        return;
+    }
+}
+
+void view_get_mailbox_stats(view_mailbox_stats_t *stats) {
+    *stats = s_stats;
+}